@@ -0,0 +1,76 @@
+#include "engines.h"
+#include <cmath>
+#include "incremental.h"
+#include "pathcursor.h"
+#include "router.h"
+#include "safestpath.h"
+#include "safetyindex.h"
+#include "streaming.h"
+#include "tiledpath.h"
+#include "wavefront.h"
+using namespace std;
+
+double streets(int rows, int cols) {
+    return double(rows) * cols;
+}
+
+double allPaths(int rows, int cols) {
+    double logPaths = lgamma(rows + cols - 1) - lgamma(rows) - lgamma(cols);
+    return exp(logPaths) * (rows + cols - 1);
+}
+
+int routeSafety(const CityGrid& grid, const Vector<GridLocation>& route) {
+    int safety = 0;
+    for (const GridLocation& loc : route) {
+        safety += grid.safety(loc.row, loc.col);
+    }
+    return safety;
+}
+
+vector<Engine> allEngines() {
+    return {
+        {"path1", true, true, streets, [](const Input& in, SolveStats* stats) {
+            return getPathSafetyVector(safestPath1(*in.city, stats));
+        }},
+        {"path2", true, true, allPaths, [](const Input& in, SolveStats* stats) {
+            return getPathSafetyVector(safestPath2(*in.city, stats));
+        }},
+        {"path3", true, true, streets, [](const Input& in, SolveStats* stats) {
+            return getPathSafetyVector(safestPath3(*in.city, stats));
+        }},
+        {"dp", false, true, streets, [](const Input& in, SolveStats* stats) {
+            return routeSafety(*in.grid, safestRouteDP(*in.grid, stats));
+        }},
+        {"linear", false, true, streets, [](const Input& in, SolveStats* stats) {
+            long peakBytes;
+            return routeSafety(*in.grid, safestRouteLinear(*in.grid, peakBytes, stats));
+        }},
+        {"tiled", false, true, streets, [](const Input& in, SolveStats* stats) {
+            return routeSafety(*in.grid, safestRouteTiled(*in.grid, 0, kDefaultTileSize, stats));
+        }},
+        {"wavefront", false, true, streets, [](const Input& in, SolveStats* stats) {
+            return routeSafety(*in.grid, safestRouteWavefront(WavefrontCity(*in.grid), WavefrontKernel::Auto, stats));
+        }},
+        {"safetyindex", false, true, streets, [](const Input& in, SolveStats* stats) {
+            return routeSafety(*in.grid, SafetyIndex(*in.grid).query(0, 0, stats));
+        }},
+        {"pathcursor", false, true, streets, [](const Input& in, SolveStats* stats) {
+            return routeSafety(*in.grid, PathCursor(*in.grid).next(stats));
+        }},
+        {"incremental", true, true, streets, [](const Input& in, SolveStats* stats) {
+            return routeSafety(*in.grid, IncrementalSolver(*in.city).route(stats));
+        }},
+        {"streaming", false, true, streets, [](const Input& in, SolveStats* stats) {
+            StreamingSolver solver(in.grid->numCols());
+            for (int r = 0; r < in.grid->numRows(); r++) {
+                solver.addRow(in.generator->row(r));
+            }
+            return solver.bestSafety(stats);
+        }},
+        {"router", false, false, streets, [](const Input& in, SolveStats* stats) {
+            StreetRouter router(*in.grid);
+            GridLocation exit(in.grid->numRows() - 1, in.grid->numCols() - 1);
+            return routeSafety(*in.grid, router.routeAStar(GridLocation(0, 0), exit, nullptr, stats));
+        }},
+    };
+}
@@ -0,0 +1,56 @@
+/*
+ * The safest path engines the benchmarks run, in one table, so the
+ * benchmark and the regression gate always cover the same engines the
+ * same way.
+ */
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "grid.h"
+#include "vector.h"
+#include "street.h"
+#include "citygen.h"
+#include "citygrid.h"
+#include "solvestats.h"
+
+/* What one city hands to the engines. The streets are only built when
+ * some engine that needs them is going to run.
+ */
+struct Input {
+    const CityGenerator* generator;
+    const CityGrid* grid;
+    const Grid<street>* city;
+};
+
+struct Engine {
+    std::string name;
+    bool needsStreets;
+    /* Whether it searches right/down paths, so its safety must match
+     * every other such engine's. The router may double back instead.
+     */
+    bool rightDown;
+    /* Work at the given size, in any unit, for scaling times between sizes. */
+    std::function<double(int rows, int cols)> work;
+    /* Solves the city and returns the safety of the path found, filling
+     * in stats when it is not null. Engines that query a prebuilt index,
+     * cursor or solver count the query, not the building.
+     */
+    std::function<int(const Input& input, SolveStats* stats)> solve;
+};
+
+/** Number of streets in the city. */
+double streets(int rows, int cols);
+
+/**
+ * Right/down paths through the city times the streets on each, which is
+ * how the exhaustive searches grow.
+ */
+double allPaths(int rows, int cols);
+
+/** Sum of the safety ratings along the route. */
+int routeSafety(const CityGrid& grid, const Vector<GridLocation>& route);
+
+/** Every engine, the three original solutions first. */
+std::vector<Engine> allEngines();
@@ -0,0 +1,567 @@
+/*
+ * Performance-regression gate for the safest path engines and the
+ * Huffman codecs.
+ *
+ * Every case is run a few times to warm up and then timed over several
+ * repeats. Its median time is compared against the median stored for it
+ * in a baseline file. A case regresses when it is slower than the
+ * baseline by more than the threshold, and the slowdown is also more than
+ * three median absolute deviations of the timings, so noise alone doesn't
+ * fail the gate. Before anything is timed, every right/down engine's best
+ * safety is checked against safestRouteDP's, so a speedup can't hide a
+ * wrong answer.
+ *
+ * This is its own program. Build it from the project's .cpp files,
+ * engines.cpp and this file, in place of main.cpp.
+ *
+ *     perfgate [--baseline bench/baseline.json] [--update] [--threshold 0.25]
+ *              [--warmup 2] [--repeats 7] [--cases prefix]
+ *
+ * With --update, the medians measured are written as the new baseline
+ * instead of being checked. Without it, a baseline that is missing or has
+ * no cases is an error, so running from the wrong directory can't pass.
+ * It exits with status 1 if any case regresses, any baseline case picked
+ * by --cases wasn't measured (say, an engine was renamed or removed), any
+ * case's disabled trace spans take over 1% of it, or any engine's answer
+ * is wrong.
+ *
+ * The baseline is a JSON file of this shape, one case per line:
+ *
+ *     {
+ *       "threshold": 0.25,
+ *       "cases": [
+ *         {"name": "solve/dp/1024", "median": 0.00512, "mad": 0.00004},
+ *         ...
+ *       ]
+ *     }
+ *
+ * Trace spans compiled in but switched off must cost under 1% of every
+ * case. Comparing medians against a SAFESTPATH_NO_TRACE build can't show
+ * a difference that small through run-to-run noise, so the gate measures
+ * it directly: it times a disabled span, counts the spans each case
+ * records with tracing on, and fails any case whose spans would take
+ * more than 1% of its median. A SAFESTPATH_NO_TRACE build has no spans
+ * and skips the check.
+ *
+ * Codec cases and the checksum case also print their throughput in MB of
+ * uncompressed data a second. The snapshot's compression ratio, the
+ * SafetyIndex's memory and the streets the router's two searches expand
+ * are printed before the table. None of these are gated; only the
+ * medians are.
+ *
+ * Timings only mean something against a baseline taken on the same
+ * machine, so refresh it with --update when the machine changes.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "blockdata.h"
+#include "citygen.h"
+#include "cityfile.h"
+#include "engines.h"
+#include "error.h"
+#include "huffmandecoder.h"
+#include "huffmanencoder.h"
+#include "packeddata.h"
+#include "router.h"
+#include "safestpath.h"
+#include "safetyindex.h"
+#include "snapshot.h"
+#include "testdata.h"
+#include "tiledpath.h"
+#include "trace.h"
+using namespace std;
+
+namespace {
+    /* City sizes the gate solves. Each engine is timed on the largest size
+     * whose work is at most kWorkCap, which keeps the exhaustive searches
+     * to the small city.
+     */
+    const int kGateSizes[] = {11, 1024};
+    const double kWorkCap = 1e8;
+    const unsigned kGateSeed = 1;
+
+    /* Most of a case's time that disabled trace spans may take. */
+    const double kMaxTraceShare = 0.01;
+
+    struct Options {
+        string baseline = "bench/baseline.json";
+        bool update = false;
+        double threshold = -1; // the baseline's, unless given
+        int warmup = 2;
+        int repeats = 7;
+        string cases;
+    };
+
+    struct Case {
+        string name;
+        function<void()> run;
+        double megabytes = 0; // uncompressed data one run handles, for MB/s
+    };
+
+    /* Raw size of a city: the three attributes as int32s plus a sidewalk byte. */
+    double rawCityMegabytes(const Grid<street>& city) {
+        return double(city.numRows()) * city.numCols() * 13 / 1e6;
+    }
+
+    struct Timing {
+        double median = 0;
+        double mad = 0;
+    };
+
+    double medianOf(vector<double> values) {
+        sort(values.begin(), values.end());
+        size_t mid = values.size() / 2;
+        return values.size() % 2 ? values[mid] : (values[mid - 1] + values[mid]) / 2;
+    }
+
+    Timing measure(const Case& c, const Options& options) {
+        for (int i = 0; i < options.warmup; i++) {
+            c.run();
+        }
+        vector<double> seconds;
+        for (int i = 0; i < options.repeats; i++) {
+            auto start = chrono::steady_clock::now();
+            c.run();
+            seconds.push_back(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        }
+        Timing timing;
+        timing.median = medianOf(seconds);
+        for (double& s : seconds) {
+            s = abs(s - timing.median);
+        }
+        timing.mad = medianOf(seconds);
+        return timing;
+    }
+
+    /* Everything the cases work on, built once before any timing. */
+    struct Fixtures {
+        map<int, unique_ptr<CityGenerator>> generators;
+        map<int, unique_ptr<CityGrid>> grids;
+        map<int, unique_ptr<Grid<street>>> cities;
+        string text;
+        PackedEncodedData packed;
+        string packedBytes;
+        string framedBytes;
+        string blockBytes;
+        string snapshotBytes;
+        map<int, string> cityFiles;
+        unique_ptr<SafetyIndex> index;
+        unique_ptr<StreetRouter> router;
+
+        ~Fixtures() {
+            for (const auto& file : cityFiles) {
+                remove(file.second.c_str());
+            }
+        }
+    };
+
+    Input inputFor(Fixtures& fixtures, int size) {
+        return {fixtures.generators[size].get(), fixtures.grids[size].get(), fixtures.cities[size].get()};
+    }
+
+    void buildFixtures(Fixtures& fixtures) {
+        for (int size : kGateSizes) {
+            fixtures.generators[size].reset(new CityGenerator(size, size, kGateSeed));
+            fixtures.grids[size].reset(new CityGrid(fixtures.generators[size]->cityGrid()));
+            fixtures.cities[size].reset(new Grid<street>(fixtures.generators[size]->city()));
+            fixtures.cityFiles[size] = "perfgate-" + to_string(size) + ".city";
+            writeCityFile(*fixtures.cities[size], fixtures.cityFiles[size]);
+        }
+
+        fixtures.text = makeTestText(size_t(8) << 20, 7);
+        vector<long long> counts(256, 0);
+        for (char ch : fixtures.text) {
+            counts[uint8_t(ch)]++;
+        }
+        HuffmanEncoder encoder(counts);
+        encoder.writeTree(fixtures.packed);
+        encoder.encode(fixtures.text.data(), fixtures.text.size(), fixtures.packed.messageBits);
+
+        stringstream packed, framed, blocks, snapshot;
+        writePackedData(fixtures.packed, packed);
+        writeFramedData(fixtures.packed, framed);
+        writeBlockData(fixtures.text.data(), fixtures.text.size(), blocks, size_t(1) << 20);
+        writeSnapshot(*fixtures.cities[1024], snapshot);
+        fixtures.index.reset(new SafetyIndex(*fixtures.grids[1024]));
+        fixtures.router.reset(new StreetRouter(*fixtures.grids[1024]));
+        fixtures.packedBytes = packed.str();
+        fixtures.framedBytes = framed.str();
+        fixtures.blockBytes = blocks.str();
+        fixtures.snapshotBytes = snapshot.str();
+    }
+
+    int gateSize(const Engine& engine) {
+        int chosen = 0;
+        for (int size : kGateSizes) {
+            if (engine.work(size, size) <= kWorkCap) chosen = size;
+        }
+        return chosen;
+    }
+
+    /*
+     * Checks every right/down engine against safestRouteDP on every gate
+     * city it can finish, and returns how many answers were wrong.
+     */
+    int crossCheck(Fixtures& fixtures) {
+        int wrong = 0;
+        for (int size : kGateSizes) {
+            Input input = inputFor(fixtures, size);
+            int expected = 0;
+            bool hasPath = true;
+            try {
+                expected = routeSafety(*input.grid, safestRouteDP(*input.grid));
+            } catch (const ErrorException&) {
+                hasPath = false;
+            }
+            for (const Engine& engine : allEngines()) {
+                if (!engine.rightDown || engine.work(size, size) > kWorkCap) continue;
+                string answer;
+                bool right;
+                try {
+                    int safety = engine.solve(input, nullptr);
+                    answer = to_string(safety);
+                    right = hasPath && safety == expected;
+                } catch (const ErrorException&) {
+                    answer = "no path";
+                    right = !hasPath;
+                }
+                if (!right) {
+                    wrong++;
+                    cout << "WRONG ANSWER " << engine.name << " on " << size << "x" << size << ": "
+                         << answer << ", expected " << (hasPath ? to_string(expected) : "no path") << endl;
+                }
+            }
+        }
+        return wrong;
+    }
+
+    vector<Case> gateCases(Fixtures& fixtures) {
+        vector<Case> cases;
+        for (const Engine& engine : allEngines()) {
+            int size = gateSize(engine);
+            if (size == 0) continue;
+            Input input = inputFor(fixtures, size);
+            function<int(const Input&, SolveStats*)> solve = engine.solve;
+            cases.push_back({"solve/" + engine.name + "/" + to_string(size), [=]() {
+                solve(input, nullptr);
+            }});
+        }
+
+        Fixtures* f = &fixtures;
+        /* The tiled engine uses every core; this shows what they add. */
+        cases.push_back({"solve/tiled/1024/1thread", [f]() {
+            safestRouteTiled(*f->grids[1024], 1);
+        }});
+
+        double textMB = fixtures.text.size() / 1e6;
+        double cityMB = rawCityMegabytes(*fixtures.cities[1024]);
+        cases.push_back({"codec/writePackedData", [f]() {
+            stringstream out;
+            writePackedData(f->packed, out);
+        }, textMB});
+        cases.push_back({"codec/readPackedData", [f]() {
+            stringstream in(f->packedBytes);
+            readPackedData(in);
+        }, textMB});
+        cases.push_back({"codec/readFramedData", [f]() {
+            stringstream in(f->framedBytes);
+            readFramedData(in);
+        }, textMB});
+        cases.push_back({"codec/tableDecode", [f]() {
+            HuffmanTableDecoder(f->packed).decodeAll(f->packed);
+        }, textMB});
+        cases.push_back({"codec/writeBlockData", [f]() {
+            stringstream out;
+            writeBlockData(f->text.data(), f->text.size(), out, size_t(1) << 20);
+        }, textMB});
+        cases.push_back({"codec/readBlockData", [f]() {
+            stringstream in(f->blockBytes);
+            readBlockData(in);
+        }, textMB});
+        /* The same on one thread, so a loss of scaling across threads shows. */
+        cases.push_back({"codec/writeBlockData/1thread", [f]() {
+            stringstream out;
+            writeBlockData(f->text.data(), f->text.size(), out, size_t(1) << 20, 1);
+        }, textMB});
+        cases.push_back({"codec/readBlockData/1thread", [f]() {
+            stringstream in(f->blockBytes);
+            readBlockData(in, 1);
+        }, textMB});
+        cases.push_back({"codec/writeSnapshot", [f]() {
+            stringstream out;
+            writeSnapshot(*f->cities[1024], out);
+        }, cityMB});
+        cases.push_back({"codec/readSnapshotGrid", [f]() {
+            stringstream in(f->snapshotBytes);
+            readSnapshotGrid(in);
+        }, cityMB});
+
+        /* The index engine builds and queries; these split the two. */
+        cases.push_back({"index/build/1024", [f]() {
+            SafetyIndex(*f->grids[1024]).memoryBytes();
+        }});
+        cases.push_back({"index/query/1024", [f]() {
+            f->index->query(0, 0);
+        }});
+
+        /* The router engine uses A*; this is the search it improves on. */
+        cases.push_back({"route/labelSetting/1024", [f]() {
+            f->router->route(GridLocation(0, 0), GridLocation(1023, 1023));
+        }});
+
+        /* Opening a mapped city shouldn't grow with its size; checking the
+         * checksum reads the whole file and should.
+         */
+        for (int size : kGateSizes) {
+            cases.push_back({"city/openMapped/" + to_string(size), [f, size]() {
+                MappedCity(f->cityFiles[size]).numRows();
+            }});
+        }
+        cases.push_back({"city/checksumMatches/1024", [f]() {
+            MappedCity(f->cityFiles[1024]).checksumMatches();
+        }, cityMB});
+        return cases;
+    }
+
+    /* The first sidewalk at or after (row, col) in the 1024x1024 city, in
+     * row-major order.
+     */
+    GridLocation sidewalkFrom(Fixtures& fixtures, int row, int col) {
+        const CityGrid& grid = *fixtures.grids[1024];
+        for (size_t i = grid.index(row, col); i < size_t(grid.numRows()) * grid.numCols(); i++) {
+            GridLocation loc(int(i / grid.numCols()), int(i % grid.numCols()));
+            if (grid.isSidewalk(loc.row, loc.col)) return loc;
+        }
+        return GridLocation(grid.numRows() - 1, grid.numCols() - 1);
+    }
+
+    /* Prints how many streets label-setting search and A* each expand
+     * between two streets.
+     */
+    void reportExpansions(Fixtures& fixtures, const string& trip, GridLocation from, GridLocation to) {
+        RouteStats plain, aStar;
+        try {
+            fixtures.router->route(from, to, &plain);
+            fixtures.router->routeAStar(from, to, &aStar);
+        } catch (const ErrorException&) {
+            printf("%s: no walk\n", trip.c_str());
+            return;
+        }
+        printf("%s: label-setting %d, A* %d\n", trip.c_str(), plain.nodesExpanded, aStar.nodesExpanded);
+    }
+
+    /* Seconds one span takes to start and end while tracing is off, the
+     * least of a few tries.
+     */
+    double disabledSpanSeconds() {
+        const int kSpans = 10000000;
+        setTracing(false);
+        double best = 1;
+        for (int tries = 0; tries < 5; tries++) {
+            auto start = chrono::steady_clock::now();
+            for (int i = 0; i < kSpans; i++) {
+                TraceSpan span("disabled span");
+            }
+            best = min(best, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        }
+        return best / kSpans;
+    }
+
+    bool selected(const string& name, const Options& options) {
+        return name.compare(0, options.cases.size(), options.cases) == 0;
+    }
+
+    /* Returns false if the file can't be read or holds no cases. */
+    bool readBaseline(const string& filename, double& threshold, map<string, Timing>& timings) {
+        ifstream in(filename);
+        if (!in) return false;
+        stringstream text;
+        text << in.rdbuf();
+        string json = text.str();
+
+        smatch match;
+        if (regex_search(json, match, regex(R"re("threshold"\s*:\s*([-+0-9.eE]+))re"))) {
+            threshold = stod(match[1]);
+        }
+        regex entry(R"re(\{\s*"name"\s*:\s*"([^"]*)"\s*,\s*"median"\s*:\s*([-+0-9.eE]+)\s*,\s*"mad"\s*:\s*([-+0-9.eE]+)\s*\})re");
+        for (sregex_iterator it(json.begin(), json.end(), entry), end; it != end; ++it) {
+            timings[(*it)[1]] = {stod((*it)[2]), stod((*it)[3])};
+        }
+        return !timings.empty();
+    }
+
+    void writeBaseline(const string& filename, double threshold,
+                       const vector<pair<string, Timing>>& timings) {
+        ofstream out(filename);
+        if (!out) {
+            error("Can't write " + filename + ".");
+        }
+        out << "{\n  \"threshold\": " << threshold << ",\n  \"cases\": [\n";
+        for (size_t i = 0; i < timings.size(); i++) {
+            char line[256];
+            snprintf(line, sizeof line, "    {\"name\": \"%s\", \"median\": %.6g, \"mad\": %.6g}%s\n",
+                     timings[i].first.c_str(), timings[i].second.median, timings[i].second.mad,
+                     i + 1 < timings.size() ? "," : "");
+            out << line;
+        }
+        out << "  ]\n}\n";
+    }
+
+    Options parseOptions(int argc, char** argv) {
+        Options options;
+        for (int i = 1; i < argc; i++) {
+            string flag = argv[i];
+            if (flag == "--update") {
+                options.update = true;
+                continue;
+            }
+            if (i + 1 == argc) {
+                error("Missing a value for " + flag + ".");
+            }
+            string value = argv[++i];
+            if (flag == "--baseline") {
+                options.baseline = value;
+            } else if (flag == "--threshold") {
+                options.threshold = stod(value);
+            } else if (flag == "--warmup") {
+                options.warmup = stoi(value);
+            } else if (flag == "--repeats") {
+                options.repeats = stoi(value);
+            } else if (flag == "--cases") {
+                options.cases = value;
+            } else {
+                error("Unknown option " + flag + ".");
+            }
+        }
+        if (options.repeats < 1 || options.warmup < 0) {
+            error("There must be at least one repeat.");
+        }
+        return options;
+    }
+}
+
+int main(int argc, char** argv) {
+    try {
+        Options options = parseOptions(argc, argv);
+        double threshold = 0.25;
+        map<string, Timing> baseline;
+        if (!readBaseline(options.baseline, threshold, baseline) && !options.update) {
+            error("No baseline cases in " + options.baseline + ". Pass --baseline with its path,"
+                  " or run with --update to create it.");
+        }
+        if (options.threshold >= 0) {
+            threshold = options.threshold;
+        }
+
+        Fixtures fixtures;
+        buildFixtures(fixtures);
+        int wrong = crossCheck(fixtures);
+        double cityMB = rawCityMegabytes(*fixtures.cities[1024]);
+        printf("Snapshot of the 1024x1024 city: %.2f MB raw, %.2f MB written, ratio %.1f\n", cityMB,
+               fixtures.snapshotBytes.size() / 1e6, cityMB * 1e6 / fixtures.snapshotBytes.size());
+        printf("SafetyIndex of the 1024x1024 city: %.2f MB, built in %.3f ms\n",
+               fixtures.index->memoryBytes() / 1e6, fixtures.index->buildSeconds() * 1e3);
+        printf("Streets the router expands in the 1024x1024 city:\n");
+        reportExpansions(fixtures, "  corner to corner", GridLocation(0, 0), GridLocation(1023, 1023));
+        reportExpansions(fixtures, "  a few blocks", sidewalkFrom(fixtures, 400, 400),
+                         sidewalkFrom(fixtures, 430, 460));
+        printf("\n");
+
+        int regressed = 0;
+        vector<pair<string, Timing>> measured;
+        vector<Case> cases = gateCases(fixtures);
+        printf("%-28s %12s %12s %9s  %s\n", "case", "baseline ms", "current ms", "change", "verdict");
+        for (const Case& c : cases) {
+            if (!selected(c.name, options)) continue;
+            Timing now = measure(c, options);
+            measured.push_back({c.name, now});
+            char rate[32] = "";
+            if (c.megabytes > 0) {
+                snprintf(rate, sizeof rate, "  %.1f MB/s", c.megabytes / now.median);
+            }
+
+            auto found = baseline.find(c.name);
+            if (found == baseline.end()) {
+                printf("%-28s %12s %12.3f %9s  %-9s%s\n", c.name.c_str(), "-", now.median * 1e3, "-", "new", rate);
+                continue;
+            }
+            const Timing& before = found->second;
+            double change = now.median / before.median - 1;
+            const char* verdict = "ok";
+            if (change > threshold && now.median - before.median > 3 * max(before.mad, now.mad)) {
+                verdict = "REGRESSED";
+                regressed++;
+            } else if (change < -threshold) {
+                verdict = "faster";
+            }
+            printf("%-28s %12.3f %12.3f %+8.1f%%  %-9s%s\n", c.name.c_str(), before.median * 1e3,
+                   now.median * 1e3, change * 100, verdict, rate);
+        }
+
+        /* Run each case once more with tracing on, only to count its spans. */
+        int overTrace = 0;
+        double spanSeconds = disabledSpanSeconds();
+        setTracing(true);
+        if (tracingEnabled()) {
+            printf("\nDisabled trace spans: %.2f ns each\n", spanSeconds * 1e9);
+            printf("%-28s %12s %12s  %s\n", "case", "spans", "share", "verdict");
+            size_t next = 0;
+            for (const Case& c : cases) {
+                if (!selected(c.name, options)) continue;
+                clearTrace();
+                c.run();
+                long long spans = traceSpansRecorded();
+                double share = spans * spanSeconds / measured[next++].second.median;
+                const char* verdict = "ok";
+                if (share > kMaxTraceShare) {
+                    verdict = "OVER";
+                    overTrace++;
+                }
+                printf("%-28s %12lld %11.4f%%  %s\n", c.name.c_str(), spans, share * 100, verdict);
+            }
+            setTracing(false);
+            clearTrace();
+            printf("\n");
+        }
+
+        /* Baseline cases that --cases picked but nothing measured. */
+        int missing = 0;
+        for (const auto& entry : baseline) {
+            bool remeasured = false;
+            for (const auto& m : measured) {
+                remeasured = remeasured || m.first == entry.first;
+            }
+            if (remeasured || !selected(entry.first, options)) continue;
+            printf("%-28s %12.3f %12s %9s  %s\n", entry.first.c_str(), entry.second.median * 1e3,
+                   "-", "-", options.update ? "dropped" : "MISSING");
+            missing++;
+        }
+
+        if (options.update) {
+            /* Cases left out with --cases keep their old baseline. */
+            for (const auto& entry : baseline) {
+                if (!selected(entry.first, options)) measured.push_back(entry);
+            }
+            writeBaseline(options.baseline, threshold, measured);
+            cout << "Wrote " << measured.size() << " cases to " << options.baseline << endl;
+            return wrong || overTrace ? 1 : 0;
+        }
+        cout << regressed << " regressed, " << missing << " missing, " << overTrace
+             << " over the trace budget, " << wrong << " wrong answers, threshold "
+             << threshold * 100 << "%" << endl;
+        return regressed || missing || overTrace || wrong ? 1 : 0;
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+}
@@ -0,0 +1,224 @@
+/*
+ * Benchmarks every safest path engine on synthetic cities from
+ * CityGenerator, from 4x4 up to 10000x10000, and writes one CSV row per
+ * engine and size: time, streets per second, the most heap the solve
+ * had in use beyond what it was handed, and the SolveStats counters for
+ * the engines that keep them.
+ *
+ * This is its own program. Build it from the project's .cpp files,
+ * engines.cpp and this file, in place of main.cpp; the SimpleTest tests compiled in with
+ * them are never run.
+ *
+ *     solverbench [--sizes 4,8,16] [--budget seconds] [--seed n]
+ *                 [--engines dp,linear] [--out results.csv] [--trace trace.json]
+ *
+ * A solve can't be stopped partway, so the time budget works by
+ * prediction: each engine's time at one size is scaled by how much more
+ * work the next size takes, and sizes predicted to run over the budget are
+ * skipped. The exhaustive solvers' work grows with the number of paths,
+ * so they drop out after the first few sizes.
+ *
+ * With --trace, every solve's phases are traced and written as Chrome
+ * trace JSON when the run ends. Tracing adds to the times, so don't
+ * compare traced runs with untraced ones.
+ */
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "citygen.h"
+#include "engines.h"
+#include "error.h"
+#include "safestpath.h"
+#include "trace.h"
+using namespace std;
+
+/* Every allocation in the program goes through here, so the benchmark can
+ * see how much heap a solve uses. Each block carries its size in front.
+ */
+namespace {
+    atomic<long long> heapInUse(0);
+    atomic<long long> heapPeak(0);
+    const size_t kHeader = 16;
+
+    void resetHeapPeak() {
+        heapPeak = heapInUse.load();
+    }
+}
+
+void* operator new(size_t size) {
+    char* block = static_cast<char*>(malloc(size + kHeader));
+    if (block == nullptr) {
+        throw bad_alloc();
+    }
+    *reinterpret_cast<size_t*>(block) = size;
+    long long inUse = heapInUse += size;
+    long long peak = heapPeak.load();
+    while (inUse > peak && !heapPeak.compare_exchange_weak(peak, inUse)) {
+    }
+    return block + kHeader;
+}
+
+void operator delete(void* pointer) noexcept {
+    if (pointer != nullptr) {
+        char* block = static_cast<char*>(pointer) - kHeader;
+        heapInUse -= *reinterpret_cast<size_t*>(block);
+        free(block);
+    }
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    operator delete(pointer);
+}
+
+namespace {
+    struct Options {
+        vector<int> sizes = {4, 8, 12, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 10000};
+        double budget = 10;
+        unsigned seed = 1;
+        vector<string> engines;
+        string out;
+        string trace;
+    };
+
+    vector<string> splitCommas(const string& text) {
+        vector<string> parts;
+        stringstream in(text);
+        string part;
+        while (getline(in, part, ',')) {
+            parts.push_back(part);
+        }
+        return parts;
+    }
+
+    Options parseOptions(int argc, char** argv) {
+        Options options;
+        for (int i = 1; i < argc; i++) {
+            string flag = argv[i];
+            if (i + 1 == argc) {
+                error("Missing a value for " + flag + ".");
+            }
+            string value = argv[++i];
+            if (flag == "--sizes") {
+                options.sizes.clear();
+                for (const string& size : splitCommas(value)) {
+                    options.sizes.push_back(stoi(size));
+                }
+            } else if (flag == "--budget") {
+                options.budget = stod(value);
+            } else if (flag == "--seed") {
+                options.seed = unsigned(stoul(value));
+            } else if (flag == "--engines") {
+                options.engines = splitCommas(value);
+            } else if (flag == "--out") {
+                options.out = value;
+            } else if (flag == "--trace") {
+                options.trace = value;
+            } else {
+                error("Unknown option " + flag + ".");
+            }
+        }
+        return options;
+    }
+
+    bool wanted(const Options& options, const string& name) {
+        if (options.engines.empty()) return true;
+        for (const string& engine : options.engines) {
+            if (engine == name) return true;
+        }
+        return false;
+    }
+}
+
+int main(int argc, char** argv) {
+    try {
+        Options options = parseOptions(argc, argv);
+        ofstream file;
+        if (!options.out.empty()) {
+            file.open(options.out);
+            if (!file) error("Can't write " + options.out + ".");
+        }
+        ostream& csv = options.out.empty() ? cout : file;
+        setTracing(!options.trace.empty());
+        csv << "engine,rows,cols,streets,status,seconds,streets_per_second,peak_heap_bytes,best_safety,"
+               "cells_visited,paths_created,queue_pushes,queue_pops,bytes_allocated,peak_frontier" << endl;
+
+        vector<Engine> engines;
+        for (const Engine& engine : allEngines()) {
+            if (wanted(options, engine.name)) engines.push_back(engine);
+        }
+        vector<double> lastSeconds(engines.size(), 0);
+        vector<double> lastWork(engines.size(), 0);
+
+        for (int size : options.sizes) {
+            CityGenerator generator(size, size, options.seed);
+            vector<bool> skip(engines.size());
+            bool streetsNeeded = false;
+            for (size_t e = 0; e < engines.size(); e++) {
+                double work = engines[e].work(size, size);
+                skip[e] = lastWork[e] > 0 && lastSeconds[e] * work / lastWork[e] > options.budget;
+                streetsNeeded = streetsNeeded || (!skip[e] && engines[e].needsStreets);
+            }
+            cerr << "Building " << size << "x" << size << " city" << endl;
+            CityGrid grid = generator.cityGrid();
+            Grid<street> city;
+            if (streetsNeeded) city = generator.city();
+            Input input = {&generator, &grid, &city};
+
+            /* Engines word a missing path differently, so check for one here. */
+            bool hasPath = true;
+            try {
+                safestRouteDP(grid);
+            } catch (const ErrorException&) {
+                hasPath = false;
+            }
+
+            for (size_t e = 0; e < engines.size(); e++) {
+                const Engine& engine = engines[e];
+                csv << engine.name << "," << size << "," << size << "," << size_t(size) * size << ",";
+                if (skip[e]) {
+                    csv << "skipped,,,,,,,,,," << endl;
+                    continue;
+                }
+                cerr << "  " << engine.name << endl;
+                resetHeapPeak();
+                long long heapBefore = heapInUse;
+                string status = "ok";
+                int safety = 0;
+                SolveStats stats;
+                auto start = chrono::steady_clock::now();
+                try {
+                    safety = engine.solve(input, &stats);
+                } catch (const ErrorException&) {
+                    status = hasPath ? "error" : "no_path";
+                }
+                double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                lastSeconds[e] = max(seconds, 1e-9);
+                lastWork[e] = engine.work(size, size);
+
+                csv << status << "," << seconds << "," << streets(size, size) / max(seconds, 1e-9) << ","
+                    << heapPeak - heapBefore << ",";
+                if (status == "ok") csv << safety;
+                csv << "," << stats.cellsVisited << "," << stats.pathsCreated << "," << stats.queuePushes
+                    << "," << stats.queuePops << "," << stats.bytesAllocated << "," << stats.peakFrontier << endl;
+            }
+        }
+
+        if (!options.trace.empty()) {
+            ofstream trace(options.trace);
+            if (!trace) error("Can't write " + options.trace + ".");
+            writeChromeTrace(trace);
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,5 +1,10 @@
 #include "bits.h"
+#include "packeddata.h"
 #include "error.h"
+#include "trace.h"
+#include "testing/SimpleTest.h"
+#include <algorithm>
+#include <cstdint>
 #include <string>
 #include <vector>
 using namespace std;
@@ -38,9 +43,9 @@ ostream& operator<< (ostream& out, Bit bit) {
 
 namespace {
     /**
-     * Validates that the given EncodedData obeys all the invariants we expect it to.
+     * Validates that the given data obeys all the invariants we expect it to.
      */
-    void checkIntegrityOf(const EncodedData& data) {
+    void checkIntegrityOf(const PackedEncodedData& data) {
         /* Number of distinct characters must be at least two. */
         if (data.treeLeaves.size() < 2) {
             error("File must contain at least two distinct characters.");
@@ -54,69 +59,106 @@ namespace {
         }
     }
 
-    /* Utility types for reading/writing individual bits. Inspired by a
-     * similar implementation by Julie Zelenski.
+    /* Utility type for writing bits. Inspired by a similar
+     * implementation by Julie Zelenski.
+     *
+     * Bits are packed into bytes lowest bit first. The writer keeps up to
+     * 64 bits in a word so that several bits can be moved at once, and
+     * writes bytes to the stream a block at a time. Since the word is
+     * filled from its low end and spilled a byte at a time from its low
+     * end, the bytes on disk are the same as packing one bit at a time.
+     * Bits are read back with BitVector::readBytes, which reads the same
+     * layout.
      */
+    const size_t kBlockBytes = 1 << 16;
+
     class BitWriter {
     public:
-        explicit BitWriter(ostream& o) : _out(o) {}
+        explicit BitWriter(ostream& o) : _out(o) {
+            _block.reserve(kBlockBytes);
+        }
         ~BitWriter() {
-            if (_bitIndex != 0) flush();
+            /* Spill the final partial byte, if any. */
+            for (int spilled = 0; spilled < _bitCount; spilled += 8) {
+                _block.push_back(char(_bitBuffer >> spilled));
+            }
+            writeBlock();
         }
 
         void put(Bit b) {
-            if (b != 0) {
-                _bitBuffer |= (1U << _bitIndex);
-            }
+            putBits(b != 0, 1);
+        }
+
+        /* Writes the low count bits of value, lowest first. 0 <= count <= 64. */
+        void putBits(uint64_t value, int count) {
+            if (count == 0) return;
+            if (count < 64) value &= (uint64_t(1) << count) - 1;
 
-            _bitIndex++;
-            if (_bitIndex == 8) {
-                flush();
+            _bitBuffer |= value << _bitCount;
+            int room = 64 - _bitCount;
+            if (count < room) {
+                _bitCount += count;
+                return;
             }
+            for (int spilled = 0; spilled < 64; spilled += 8) {
+                _block.push_back(char(_bitBuffer >> spilled));
+            }
+            if (_block.size() >= kBlockBytes) writeBlock();
+            _bitBuffer = (room == 64) ? 0 : value >> room;
+            _bitCount = count - room;
         }
 
     private:
-        void flush() {
-            _out.put(_bitBuffer);
-            _bitBuffer = 0;
-            _bitIndex = 0;
+        void writeBlock() {
+            _out.write(_block.data(), _block.size());
+            _block.clear();
         }
 
         ostream& _out;
-        uint8_t _bitBuffer = 0;
-        uint8_t _bitIndex  = 0;
+        vector<char> _block;
+        uint64_t _bitBuffer = 0;
+        int _bitCount = 0;
     };
 
-    class BitReader {
-    public:
-        explicit BitReader(istream& i) : _in(i) {}
+    /* "CS106B A7" */
+    const uint32_t kFileHeader = 0xC5106BA7;
 
-        Bit get() {
-            if (_bitIndex == 8) readMore();
+    /* One past kFileHeader, for the framed format. */
+    const uint32_t kFramedHeader = 0xC5106BA8;
 
-            Bit result = !!(_bitBuffer & (1U << _bitIndex));
-            _bitIndex++;
-            return result;
+    /* Reads the magic header at the front of both formats. */
+    uint32_t readHeader(istream& in) {
+        uint32_t header;
+        if (!in.read(reinterpret_cast<char *>(&header), sizeof header)) {
+            error("Chosen file is not a Huffman-compressed file.");
         }
+        return header;
+    }
 
-    private:
-        istream& _in;
-        uint8_t _bitBuffer = 0;
-        uint8_t _bitIndex  = 8;
-
-        void readMore() {
-            char read;
-            if (!_in.get(read)) {
-                error("Unexpected end of file when reading bits.");
-            }
+    /* Reads the character count and the tree leaves that follow the magic
+     * header in both formats.
+     */
+    void readTreeLeaves(istream& in, vector<char>& leaves) {
+        /* Read the character count. */
+        char skewCharCount;
+        if (!in.get(skewCharCount)) {
+            error("Error reading character count.");
+        }
 
-            _bitBuffer = read;
-            _bitIndex = 0;
+        /* We offset this by one - add the one back. */
+        int charCount = uint8_t(skewCharCount);
+        charCount++;
+
+        if (charCount < 2) {
+            error("Character count is too low for this to be a valid file.");
         }
-    };
 
-    /* "CS106B A7" */
-    const uint32_t kFileHeader = 0xC5106BA7;
+        /* Read in the leaves. */
+        leaves.resize(charCount);
+        if (!in.read(leaves.data(), leaves.size())) {
+            error("Could not read in all tree leaves.");
+        }
+    }
 }
 
 /**
@@ -131,7 +173,7 @@ namespace {
  * We don't need to store how many bits are in the tree, since it's always given
  * by 2*c - 1, as this is the number of nodes in a full binary tree with c leaves.
  */
-void writeData(EncodedData& data, ostream& out) {
+void writePackedData(const PackedEncodedData& data, ostream& out) {
     /* Validate invariants. */
     checkIntegrityOf(data);
 
@@ -143,55 +185,69 @@ void writeData(EncodedData& data, ostream& out) {
     out.put(charByte);
 
     /* Tree leaves. */
-    while (!data.treeLeaves.isEmpty()) out.put(data.treeLeaves.dequeue());
+    out.write(data.treeLeaves.data(), data.treeLeaves.size());
 
     /* Number of bits in the last byte to read. */
     uint8_t modulus = (data.treeShape.size() + data.messageBits.size()) % 8;
     if (modulus == 0) modulus = 8;
     out.put(modulus);
 
-    /* Bits themselves. */
+    /* Bits themselves. The tree has an odd number of bits, so the message
+     * bits are never byte-aligned in the file; the writer shifts them into
+     * place a word at a time.
+     */
     BitWriter writer(out);
-    while (!data.treeShape.isEmpty()) writer.put(data.treeShape.dequeue());
-    while (!data.messageBits.isEmpty()) writer.put(data.messageBits.dequeue());
-}
-
-/**
- * Reads EncodedData from stream.
- */
-EncodedData readData(istream& in) {
-    /* Read back the magic header and make sure it matches. */
-    uint32_t header;
-    if (!in.read(reinterpret_cast<char *>(&header), sizeof header) ||
-        header != kFileHeader) {
-        error("Chosen file is not a Huffman-compressed file.");
+    for (size_t i = 0; i < data.treeShape.size(); i += 64) {
+        int count = int(min<size_t>(64, data.treeShape.size() - i));
+        writer.putBits(data.treeShape.getBits(i, count), count);
     }
-
-    EncodedData data;
-
-    /* Read the character count. */
-    char skewCharCount;
-    if (!in.get(skewCharCount)) {
-        error("Error reading character count.");
+    for (size_t i = 0; i < data.messageBits.size(); i += 64) {
+        int count = int(min<size_t>(64, data.messageBits.size() - i));
+        writer.putBits(data.messageBits.getBits(i, count), count);
     }
+}
 
-    /* We offset this by one - add the one back. */
-    int charCount = uint8_t(skewCharCount);
-    charCount++;
+void writeData(EncodedData& data, ostream& out) {
+    TraceSpan writing("writeData");
+    TraceSpan packing("writeData pack");
+    PackedEncodedData packed = packData(data);
+    packing.end();
+    writePackedData(packed, out);
+}
 
-    if (charCount < 2) {
-        error("Character count is too low for this to be a valid file.");
+/* Reads every block the reader hands out into one PackedEncodedData. */
+static PackedEncodedData readAllBlocks(FramedDataReader& reader) {
+    PackedEncodedData data;
+    data.treeShape = reader.treeShape();
+    data.treeLeaves = reader.treeLeaves();
+    BitVector block;
+    while (reader.nextBlock(block)) {
+        data.messageBits.addAll(block);
     }
+    return data;
+}
 
-    /* Read in the leaves. */
-    vector<char> leaves(charCount);
-    if (!in.read(leaves.data(), leaves.size())) {
-        error("Could not read in all tree leaves.");
+/**
+ * Reads packed data from stream.
+ */
+PackedEncodedData readPackedData(istream& in) {
+    /* The framed format is read a frame at a time, and so is anything from
+     * a pipe, which can't seek to count the bits.
+     */
+    uint32_t header = readHeader(in);
+    if (header == kFramedHeader || in.tellg() == istream::pos_type(-1)) {
+        in.clear();
+        FramedDataReader reader(in, header);
+        return readAllBlocks(reader);
     }
-    for (char leaf: leaves) {
-        data.treeLeaves.enqueue(leaf);
+    if (header != kFileHeader) {
+        error("Chosen file is not a Huffman-compressed file.");
     }
 
+    PackedEncodedData data;
+    readTreeLeaves(in, data.treeLeaves);
+    int charCount = data.treeLeaves.size();
+
     /* Read in the modulus. */
     char signedModulus;
     if (!in.get(signedModulus)) {
@@ -215,22 +271,190 @@ EncodedData readData(istream& in) {
     }
 
     /* Number of bits to read = (#bytes - 1) * 8 + modulus. */
-    uint64_t bitsToRead = (endPos - currPos - 1) * 8 + modulus;
+    uint64_t treeBits = 2 * charCount - 1;
+    if (endPos - currPos < 1 || modulus < 1 || modulus > 8 ||
+        uint64_t(endPos - currPos - 1) * 8 + modulus < treeBits) {
+        error("Unexpected end of file when reading bits.");
+    }
+    uint64_t bitsToRead = uint64_t(endPos - currPos - 1) * 8 + modulus;
 
-    /* Read in the tree shape bits. */
-    BitReader reader(in);
-    for (int i = 0; i < 2 * charCount - 1; i++) {
-        data.treeShape.enqueue(reader.get());
-        bitsToRead--;
+    /* Read every bit in one go, then split the tree bits off the front. */
+    if (!data.messageBits.readBytes(in, bitsToRead)) {
+        error("Unexpected end of file when reading bits.");
+    }
+    for (uint64_t i = 0; i < treeBits; i += 64) {
+        int count = int(min<uint64_t>(64, treeBits - i));
+        data.treeShape.addBits(data.messageBits.getBits(i, count), count);
     }
+    data.messageBits.removeFront(treeBits);
+    return data;
+}
 
-    /* Read in the message bits. */
-    while (bitsToRead > 0) {
-        data.messageBits.enqueue(reader.get());
-        bitsToRead--;
+/**
+ * Reads EncodedData from stream.
+ */
+EncodedData readData(istream& in) {
+    TraceSpan reading("readData");
+    PackedEncodedData packed = readPackedData(in);
+    TraceSpan unpacking("readData unpack");
+    return unpackData(packed);
+}
+
+PackedEncodedData packData(EncodedData& data) {
+    PackedEncodedData packed;
+    while (!data.treeShape.isEmpty()) packed.treeShape.add(data.treeShape.dequeue() != 0);
+    while (!data.treeLeaves.isEmpty()) packed.treeLeaves.push_back(data.treeLeaves.dequeue());
+    packed.messageBits.reserve(data.messageBits.size());
+    while (!data.messageBits.isEmpty()) packed.messageBits.add(data.messageBits.dequeue() != 0);
+    return packed;
+}
+
+EncodedData unpackData(const PackedEncodedData& data) {
+    EncodedData unpacked;
+    for (size_t i = 0; i < data.treeShape.size(); i++) {
+        unpacked.treeShape.enqueue(int(data.treeShape[i]));
+    }
+    for (char leaf : data.treeLeaves) {
+        unpacked.treeLeaves.enqueue(leaf);
+    }
+    for (size_t i = 0; i < data.messageBits.size(); i++) {
+        unpacked.messageBits.enqueue(int(data.messageBits[i]));
     }
+    return unpacked;
+}
 
-    return data;
+void writeFramedData(const PackedEncodedData& data, ostream& out, size_t frameBits) {
+    checkIntegrityOf(data);
+    if (frameBits < 1 || frameBits > UINT32_MAX) {
+        error("A frame must hold between 1 and 2^32 - 1 bits.");
+    }
+
+    out.write(reinterpret_cast<const char *>(&kFramedHeader), sizeof kFramedHeader);
+    const uint8_t charByte = data.treeLeaves.size() - 1;
+    out.put(charByte);
+    out.write(data.treeLeaves.data(), data.treeLeaves.size());
+    data.treeShape.writeBytes(out);
+
+    BitVector frame;
+    for (size_t start = 0; start < data.messageBits.size(); start += frameBits) {
+        size_t end = min(start + frameBits, data.messageBits.size());
+        frame.clear();
+        for (size_t i = start; i < end; i += 64) {
+            int count = int(min<size_t>(64, end - i));
+            frame.addBits(data.messageBits.getBits(i, count), count);
+        }
+        uint32_t frameSize = uint32_t(frame.size());
+        out.write(reinterpret_cast<const char *>(&frameSize), sizeof frameSize);
+        frame.writeBytes(out);
+    }
+    const uint32_t endMarker = 0;
+    out.write(reinterpret_cast<const char *>(&endMarker), sizeof endMarker);
+}
+
+FramedDataReader::FramedDataReader(istream& in) : FramedDataReader(in, readHeader(in)) {
+}
+
+FramedDataReader::FramedDataReader(istream& in, uint32_t header) : _in(in) {
+    if (header != kFileHeader && header != kFramedHeader) {
+        error("Chosen file is not a Huffman-compressed file.");
+    }
+    _framed = (header == kFramedHeader);
+    readTreeLeaves(in, _treeLeaves);
+    size_t treeBits = 2 * _treeLeaves.size() - 1;
+
+    if (_framed) {
+        if (!_treeShape.readBytes(in, treeBits)) {
+            error("Unexpected end of file when reading bits.");
+        }
+        return;
+    }
+
+    /* The writeData format: the modulus, then tree bits and message bits
+     * run together. Read until the whole tree is in and keep the rest.
+     */
+    char signedModulus;
+    if (!in.get(signedModulus)) {
+        error("Error reading modulus.");
+    }
+    _modulus = uint8_t(signedModulus);
+    if (_modulus < 1 || _modulus > 8) {
+        error("Error reading modulus.");
+    }
+    _buffer.resize(kBlockBytes);
+    BitVector block;
+    while (_leftover.size() < treeBits && readUnframedBytes(block)) {
+        _leftover.addAll(block);
+    }
+    if (_leftover.size() < treeBits) {
+        error("Unexpected end of file when reading bits.");
+    }
+    for (size_t i = 0; i < treeBits; i += 64) {
+        int count = int(min<size_t>(64, treeBits - i));
+        _treeShape.addBits(_leftover.getBits(i, count), count);
+    }
+    _leftover.removeFront(treeBits);
+}
+
+/*
+ * Reads the next block of the writeData format. The last byte of the
+ * stream may be only partly used, so every block holds back its last byte
+ * until the next read shows whether more follow.
+ */
+bool FramedDataReader::readUnframedBytes(BitVector& bits) {
+    if (_done) return false;
+    bits.clear();
+    _in.read(_buffer.data(), _buffer.size());
+    size_t got = size_t(_in.gcount());
+    if (got == 0) {
+        _done = true;
+        if (!_hasHeld) {
+            error("Unexpected end of file when reading bits.");
+        }
+        bits.addBits(uint8_t(_held), _modulus);
+        return true;
+    }
+    if (_hasHeld) {
+        bits.addBits(uint8_t(_held), 8);
+    }
+    for (size_t i = 0; i + 1 < got; i++) {
+        bits.addBits(uint8_t(_buffer[i]), 8);
+    }
+    _held = _buffer[got - 1];
+    _hasHeld = true;
+    return true;
+}
+
+bool FramedDataReader::nextBlock(BitVector& bits) {
+    if (!_framed) {
+        if (!_leftover.isEmpty()) {
+            swap(bits, _leftover);
+            _leftover.clear();
+            return true;
+        }
+        while (readUnframedBytes(bits)) {
+            if (!bits.isEmpty()) return true;
+        }
+        return false;
+    }
+
+    if (_done) return false;
+    uint32_t frameSize;
+    if (!_in.read(reinterpret_cast<char *>(&frameSize), sizeof frameSize)) {
+        error("Unexpected end of file when reading bits.");
+    }
+    if (frameSize == 0) {
+        _done = true;
+        return false;
+    }
+    if (!bits.readBytes(_in, frameSize)) {
+        error("Unexpected end of file when reading bits.");
+    }
+    return true;
+}
+
+PackedEncodedData readFramedData(istream& in) {
+    FramedDataReader reader(in);
+    return readAllBlocks(reader);
 }
 
 /* For debugging purposes. */
@@ -244,6 +468,189 @@ ostream& operator<< (ostream& out, const EncodedData& data) {
 }
 
 
+/* Packs bits into bytes one at a time, lowest bit first, the way the
+ * original single-bit BitWriter did.
+ */
+static string packOneAtATime(const vector<int>& bits) {
+    string bytes;
+    for (size_t i = 0; i < bits.size(); i++) {
+        if (i % 8 == 0) bytes += char(0);
+        if (bits[i]) bytes.back() |= char(1 << (i % 8));
+    }
+    return bytes;
+}
+
+STUDENT_TEST("Word-at-a-time bit I/O matches packing one bit at a time"){
+    for (int length = 0; length < 300; length += 7){
+        vector<int> bits;
+        unsigned seed = length + 1;
+        for (int i = 0; i < length; i++){
+            seed = seed * 1103515245 + 12345;
+            bits.push_back((seed >> 16) & 1);
+        }
+
+        /* Write in uneven runs of up to 64 bits. */
+        ostringstream out;
+        {
+            BitWriter writer(out);
+            size_t i = 0;
+            for (int run = 1; i < bits.size(); run = run % 64 + 1){
+                uint64_t value = 0;
+                int count = 0;
+                for (; count < run && i < bits.size(); count++, i++){
+                    value |= uint64_t(bits[i]) << count;
+                }
+                writer.putBits(value, count);
+            }
+        }
+        EXPECT_EQUAL(out.str(), packOneAtATime(bits));
+
+        /* Read back the way readPackedData and FramedDataReader do. */
+        istringstream in(out.str());
+        BitVector readBack;
+        EXPECT(readBack.readBytes(in, bits.size()));
+        bool same = readBack.size() == bits.size();
+        for (size_t i = 0; same && i < bits.size(); i++){
+            same = int(readBack[i]) == bits[i];
+        }
+        EXPECT(same);
+        istringstream tooShort(out.str());
+        EXPECT(!readBack.readBytes(tooShort, (bits.size() + 7) / 8 * 8 + 1));
+    }
+}
+
+STUDENT_TEST("writeData and readData round-trip packed and queued data"){
+    for (int length = 1; length < 500; length += 37){
+        EncodedData data;
+        for (int bit : {1, 0, 1, 0, 0}) data.treeShape.enqueue(bit);
+        for (char leaf : {'a', 'b', 'c'}) data.treeLeaves.enqueue(leaf);
+        for (int i = 0; i < length; i++){
+            data.messageBits.enqueue((i * i + length) % 3 == 0);
+        }
+        EncodedData expected = data;
+
+        EncodedData copy = data;
+        PackedEncodedData packed = packData(copy);
+
+        stringstream file;
+        writeData(data, file);
+        EncodedData actual = readData(file);
+        EXPECT(actual.treeShape == expected.treeShape);
+        EXPECT(actual.treeLeaves == expected.treeLeaves);
+        EXPECT(actual.messageBits == expected.messageBits);
+
+        /* The packed form writes the same bytes and reads back the same bits. */
+        stringstream packedFile;
+        writePackedData(packed, packedFile);
+        EXPECT_EQUAL(packedFile.str(), file.str());
+        PackedEncodedData packedBack = readPackedData(packedFile);
+        EXPECT(packedBack.treeShape == packed.treeShape);
+        EXPECT(packedBack.treeLeaves == packed.treeLeaves);
+        EXPECT(packedBack.messageBits == packed.messageBits);
+    }
+}
+
+
+/* A stream buffer that hands out a string a byte at a time and can't
+ * seek, like a pipe.
+ */
+class PipeBuffer : public streambuf {
+public:
+    explicit PipeBuffer(const string& data) : _data(data) {}
+
+protected:
+    int_type underflow() override {
+        if (_pos == _data.size()) return traits_type::eof();
+        _current = _data[_pos++];
+        setg(&_current, &_current, &_current + 1);
+        return traits_type::to_int_type(_current);
+    }
+
+private:
+    string _data;
+    size_t _pos = 0;
+    char _current = 0;
+};
+
+static PackedEncodedData makePackedData(int length) {
+    PackedEncodedData data;
+    for (int bit : {1, 1, 0, 0, 1, 0, 0}) data.treeShape.add(bit);
+    for (char leaf : {'x', 'y', 'z', 'w'}) data.treeLeaves.push_back(leaf);
+    for (int i = 0; i < length; i++){
+        data.messageBits.add((i * 7 + length) % 5 < 2);
+    }
+    return data;
+}
+
+STUDENT_TEST("Framed data is read a frame at a time, even from a pipe"){
+    for (int length = 1; length < 2000; length += 311){
+        PackedEncodedData data = makePackedData(length);
+        stringstream file;
+        writeFramedData(data, file, 100);
+
+        PipeBuffer pipe(file.str());
+        istream in(&pipe);
+        FramedDataReader reader(in);
+        EXPECT(reader.treeShape() == data.treeShape);
+        EXPECT(reader.treeLeaves() == data.treeLeaves);
+        BitVector block;
+        BitVector message;
+        while (reader.nextBlock(block)){
+            EXPECT(block.size() <= 100);
+            message.addAll(block);
+        }
+        EXPECT(message == data.messageBits);
+        EXPECT(!reader.nextBlock(block));
+
+        /* Without the end marker the stream was cut short. */
+        string cut = file.str().substr(0, file.str().size() - 4);
+        stringstream cutFile(cut);
+        EXPECT_ERROR(readFramedData(cutFile));
+    }
+}
+
+STUDENT_TEST("Framed data is read by readPackedData and readData from a file that can seek"){
+    for (int length : {1, 9, 312, 1999}){
+        PackedEncodedData data = makePackedData(length);
+        stringstream file;
+        writeFramedData(data, file, 100);
+
+        stringstream in(file.str());
+        PackedEncodedData actual = readPackedData(in);
+        EXPECT(actual.treeShape == data.treeShape);
+        EXPECT(actual.treeLeaves == data.treeLeaves);
+        EXPECT(actual.messageBits == data.messageBits);
+
+        stringstream queuedIn(file.str());
+        EncodedData queued = readData(queuedIn);
+        EXPECT_EQUAL(queued.messageBits.size(), length);
+    }
+    stringstream notHuffman("not a Huffman file");
+    EXPECT_ERROR(readPackedData(notHuffman));
+}
+
+STUDENT_TEST("Data in the writeData format can be read from a pipe"){
+    /* The longest spans several of the reader's blocks. */
+    for (int length : {1, 9, 312, 1999, 1000003}){
+        PackedEncodedData data = makePackedData(length);
+        stringstream file;
+        writePackedData(data, file);
+
+        PipeBuffer pipe(file.str());
+        istream in(&pipe);
+        PackedEncodedData actual = readPackedData(in);
+        EXPECT(actual.treeShape == data.treeShape);
+        EXPECT(actual.treeLeaves == data.treeLeaves);
+        EXPECT(actual.messageBits == data.messageBits);
+
+        PipeBuffer queuedPipe(file.str());
+        istream queuedIn(&queuedPipe);
+        EncodedData queued = readData(queuedIn);
+        EXPECT_EQUAL(queued.messageBits.size(), length);
+    }
+}
+
+
 
 //#include <string>
 //#include "grid.h"
@@ -0,0 +1,177 @@
+#include "bitvector.h"
+#include "error.h"
+#include "testing/SimpleTest.h"
+#include <algorithm>
+#include <sstream>
+using namespace std;
+
+void BitVector::set(size_t index, bool bit) {
+    if (index >= _size) {
+        error("Bit index is out of range.");
+    }
+    uint64_t mask = uint64_t(1) << (index % 64);
+    if (bit) {
+        _words[index / 64] |= mask;
+    } else {
+        _words[index / 64] &= ~mask;
+    }
+}
+
+void BitVector::addBits(uint64_t bits, int count) {
+    if (count == 0) return;
+    if (count < 64) bits &= (uint64_t(1) << count) - 1;
+
+    int used = _size % 64;
+    if (used == 0) {
+        _words.push_back(bits);
+    } else {
+        _words.back() |= bits << used;
+        if (used + count > 64) {
+            _words.push_back(bits >> (64 - used));
+        }
+    }
+    _size += count;
+}
+
+void BitVector::addAll(const BitVector& other) {
+    if (_size % 64 == 0) {
+        _words.insert(_words.end(), other._words.begin(), other._words.end());
+        _size += other._size;
+        return;
+    }
+    reserve(_size + other._size);
+    size_t whole = other._size / 64;
+    for (size_t i = 0; i < whole; i++) {
+        addBits(other._words[i], 64);
+    }
+    addBits(other.getBits(whole * 64, int(other._size % 64)), int(other._size % 64));
+}
+
+uint64_t BitVector::getBits(size_t index, int count) const {
+    if (count == 0) return 0;
+    size_t word = index / 64;
+    int offset = index % 64;
+    uint64_t bits = (word < _words.size()) ? _words[word] >> offset : 0;
+    if (offset != 0 && word + 1 < _words.size()) {
+        bits |= _words[word + 1] << (64 - offset);
+    }
+    if (count < 64) bits &= (uint64_t(1) << count) - 1;
+    return bits;
+}
+
+void BitVector::removeFront(size_t count) {
+    if (count >= _size) {
+        clear();
+        return;
+    }
+    size_t shiftWords = count / 64;
+    int shiftBits = count % 64;
+    size_t remaining = _size - count;
+    size_t keepWords = (remaining + 63) / 64;
+    for (size_t i = 0; i < keepWords; i++) {
+        uint64_t bits = _words[i + shiftWords] >> shiftBits;
+        if (shiftBits != 0 && i + shiftWords + 1 < _words.size()) {
+            bits |= _words[i + shiftWords + 1] << (64 - shiftBits);
+        }
+        _words[i] = bits;
+    }
+    _words.resize(keepWords);
+    _size = remaining;
+    clearUnusedBits();
+}
+
+void BitVector::clear() {
+    _words.clear();
+    _size = 0;
+}
+
+void BitVector::reserve(size_t bits) {
+    _words.reserve((bits + 63) / 64);
+}
+
+bool BitVector::readBytes(istream& in, size_t numBits) {
+    _words.assign((numBits + 63) / 64, 0);
+    _size = numBits;
+    size_t bytes = (numBits + 7) / 8;
+    bool complete = bool(in.read(reinterpret_cast<char*>(_words.data()), bytes));
+    clearUnusedBits();
+    return complete;
+}
+
+void BitVector::writeBytes(ostream& out) const {
+    out.write(reinterpret_cast<const char*>(_words.data()), (_size + 7) / 8);
+}
+
+void BitVector::clearUnusedBits() {
+    if (_size % 64 != 0) {
+        _words.back() &= (uint64_t(1) << (_size % 64)) - 1;
+    }
+}
+
+
+STUDENT_TEST("BitVector appends, reads and drops bits across word boundaries"){
+    BitVector bits;
+    vector<bool> expected;
+    unsigned seed = 7;
+    for (int count = 1; count <= 64; count++){
+        seed = seed * 1103515245 + 12345;
+        uint64_t value = (uint64_t(seed) << 32) ^ (seed * 2654435761u);
+        bits.addBits(value, count);
+        for (int i = 0; i < count; i++){
+            expected.push_back((value >> i) & 1);
+        }
+    }
+    EXPECT_EQUAL(bits.size(), expected.size());
+    bool same = true;
+    for (size_t i = 0; i < expected.size(); i++){
+        same = same && bits[i] == expected[i];
+    }
+    EXPECT(same);
+    for (size_t start = 0; start < expected.size(); start += 13){
+        int count = int(min<size_t>(64, expected.size() - start));
+        uint64_t value = bits.getBits(start, count);
+        for (int i = 0; i < count; i++){
+            same = same && bool((value >> i) & 1) == expected[start + i];
+        }
+    }
+    EXPECT(same);
+
+    /* Appending one vector to another matches appending bit by bit. */
+    BitVector joined;
+    joined.addBits(5, 3);
+    joined.addAll(bits);
+    BitVector oneByOne;
+    oneByOne.addBits(5, 3);
+    for (bool bit : expected){
+        oneByOne.add(bit);
+    }
+    EXPECT(joined == oneByOne);
+
+    joined.removeFront(3);
+    EXPECT(joined == bits);
+    bits.removeFront(100);
+    BitVector tail;
+    for (size_t i = 100; i < expected.size(); i++){
+        tail.add(expected[i]);
+    }
+    EXPECT(bits == tail);
+    bits.set(0, !tail[0]);
+    EXPECT(bits != tail);
+    EXPECT_ERROR(bits.set(bits.size(), true));
+}
+
+STUDENT_TEST("BitVector reads and writes packed bytes in one go"){
+    BitVector bits;
+    for (int i = 0; i < 1001; i++){
+        bits.add(i % 3 == 0 || i % 7 == 0);
+    }
+    stringstream file;
+    bits.writeBytes(file);
+    EXPECT_EQUAL(file.str().size(), 126);
+    EXPECT_EQUAL(file.str()[0], char(0b11001001));
+
+    BitVector readBack;
+    EXPECT(readBack.readBytes(file, 1001));
+    EXPECT(readBack == bits);
+    EXPECT(!readBack.readBytes(file, 8));
+}
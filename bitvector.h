@@ -0,0 +1,87 @@
+/*
+ * BitVector is a packed, growable sequence of bits: 64 to a word, bit i in
+ * word i / 64 at position i % 64. That is the same order bits.cpp packs
+ * them into bytes on disk (lowest bit of each byte first), so on a
+ * little-endian machine a BitVector's words are byte-for-byte the bits as
+ * stored in a file, and can be read or written with one stream call.
+ *
+ * Bits past the end of the last word are always zero, so two vectors can
+ * be compared a word at a time.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+class BitVector {
+public:
+    BitVector() = default;
+
+    size_t size() const {
+        return _size;
+    }
+    bool isEmpty() const {
+        return _size == 0;
+    }
+
+    bool get(size_t index) const {
+        return (_words[index / 64] >> (index % 64)) & 1;
+    }
+    bool operator [](size_t index) const {
+        return get(index);
+    }
+    void set(size_t index, bool bit);
+
+    /** Appends one bit. */
+    void add(bool bit) {
+        addBits(bit, 1);
+    }
+
+    /** Appends the low count bits of bits, lowest first. 0 <= count <= 64. */
+    void addBits(uint64_t bits, int count);
+
+    /** Appends every bit of other. */
+    void addAll(const BitVector& other);
+
+    /**
+     * Returns count bits starting at index, lowest first. 0 <= count <= 64.
+     * Bits past the end read as zero.
+     */
+    uint64_t getBits(size_t index, int count) const;
+
+    /** Removes the first count bits, shifting the rest down in place. */
+    void removeFront(size_t count);
+
+    void clear();
+    void reserve(size_t bits);
+
+    /**
+     * Replaces the contents with numBits bits read straight from the stream
+     * into the words, packed the way bits.cpp writes them. Returns whether
+     * every byte could be read.
+     */
+    bool readBytes(std::istream& in, size_t numBits);
+
+    /** Writes the bits to the stream as (size() + 7) / 8 packed bytes. */
+    void writeBytes(std::ostream& out) const;
+
+    /** Bytes of heap memory holding the bits. */
+    size_t memoryBytes() const {
+        return _words.capacity() * sizeof(uint64_t);
+    }
+
+    bool operator ==(const BitVector& other) const {
+        return _size == other._size && _words == other._words;
+    }
+    bool operator !=(const BitVector& other) const {
+        return !(*this == other);
+    }
+
+private:
+    void clearUnusedBits();
+
+    std::vector<uint64_t> _words;
+    size_t _size = 0;
+};
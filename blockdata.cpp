@@ -0,0 +1,281 @@
+#include "blockdata.h"
+#include "huffmanencoder.h"
+#include "packeddata.h"
+#include "error.h"
+#include "trace.h"
+#include "testing/SimpleTest.h"
+#include "testdata.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+using namespace std;
+
+namespace {
+    /* One past kFramedHeader in bits.cpp. */
+    const uint32_t kBlockHeader = 0xC5106BA9;
+
+    /*
+     * Calls work(block) for every block on a fixed pool of threads, each
+     * claiming the next unclaimed block until none are left. The first
+     * error any block raises is raised again here once every thread stops.
+     */
+    void forEachBlock(size_t numBlocks, int numThreads, const function<void(size_t)>& work) {
+        if (numThreads <= 0) {
+            numThreads = max(1, int(thread::hardware_concurrency()));
+        }
+        numThreads = int(min<size_t>(numThreads, max<size_t>(numBlocks, 1)));
+
+        atomic<size_t> claimed(0);
+        mutex failureMutex;
+        exception_ptr failure;
+        auto run = [&]() {
+            for (size_t block = claimed++; block < numBlocks; block = claimed++) {
+                try {
+                    work(block);
+                } catch (...) {
+                    lock_guard<mutex> lock(failureMutex);
+                    if (!failure) failure = current_exception();
+                    claimed = numBlocks;
+                }
+            }
+        };
+
+        vector<thread> workers;
+        for (int i = 1; i < numThreads; i++) {
+            workers.emplace_back(run);
+        }
+        run();
+        for (thread& worker : workers) {
+            worker.join();
+        }
+        if (failure) {
+            rethrow_exception(failure);
+        }
+    }
+
+    void writeSize(ostream& out, uint64_t value) {
+        out.write(reinterpret_cast<const char *>(&value), sizeof value);
+    }
+
+    uint64_t readSize(istream& in) {
+        uint64_t value;
+        if (!in.read(reinterpret_cast<char *>(&value), sizeof value)) {
+            error("The block data ended in the middle of its index.");
+        }
+        return value;
+    }
+}
+
+void writeBlockData(const char* chars, size_t size, ostream& out, size_t blockChars, int numThreads) {
+    if (blockChars < 1) {
+        error("A block must hold at least one character.");
+    }
+    size_t numBlocks = (size + blockChars - 1) / blockChars;
+
+    /* Count the characters in parallel a chunk at a time, then build one
+     * tree from the totals.
+     */
+    const size_t chunkChars = size_t(1) << 20;
+    size_t numChunks = (size + chunkChars - 1) / chunkChars;
+    vector<vector<long long>> chunkCounts(numChunks, vector<long long>(256, 0));
+    forEachBlock(numChunks, numThreads, [&](size_t chunk) {
+        size_t end = min(size, (chunk + 1) * chunkChars);
+        for (size_t i = chunk * chunkChars; i < end; i++) {
+            chunkCounts[chunk][uint8_t(chars[i])]++;
+        }
+    });
+    vector<long long> counts(256, 0);
+    for (const vector<long long>& chunkCount : chunkCounts) {
+        for (int b = 0; b < 256; b++) {
+            counts[b] += chunkCount[b];
+        }
+    }
+    HuffmanEncoder encoder(counts);
+
+    vector<BitVector> blocks(numBlocks);
+    forEachBlock(numBlocks, numThreads, [&](size_t block) {
+        TraceSpan encoding("encode block");
+        size_t start = block * blockChars;
+        encoder.encode(chars + start, min(blockChars, size - start), blocks[block]);
+    });
+
+    PackedEncodedData tree;
+    encoder.writeTree(tree);
+    out.write(reinterpret_cast<const char *>(&kBlockHeader), sizeof kBlockHeader);
+    const uint8_t charByte = tree.treeLeaves.size() - 1;
+    out.put(charByte);
+    out.write(tree.treeLeaves.data(), tree.treeLeaves.size());
+    tree.treeShape.writeBytes(out);
+    writeSize(out, blockChars);
+    writeSize(out, size);
+    for (const BitVector& block : blocks) {
+        writeSize(out, block.size());
+    }
+    for (const BitVector& block : blocks) {
+        block.writeBytes(out);
+    }
+}
+
+BlockDataReader::BlockDataReader(istream& in) : _in(in) {
+    uint32_t header;
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof header) || header != kBlockHeader) {
+        error("Chosen file is not in the block format.");
+    }
+
+    char skewCharCount;
+    if (!in.get(skewCharCount)) {
+        error("Error reading character count.");
+    }
+    _treeLeaves.resize(size_t(uint8_t(skewCharCount)) + 1);
+    if (_treeLeaves.size() < 2) {
+        error("Character count is too low for this to be a valid file.");
+    }
+    if (!in.read(_treeLeaves.data(), _treeLeaves.size()) ||
+        !_treeShape.readBytes(in, _treeLeaves.size() * 2 - 1)) {
+        error("Could not read in the tree.");
+    }
+    _decoder.reset(new HuffmanTableDecoder(_treeShape, _treeLeaves));
+
+    _blockSize = readSize(in);
+    _size = readSize(in);
+    if (_blockSize < 1) {
+        error("The block data's header is damaged.");
+    }
+    size_t numBlocks = _size / _blockSize + (_size % _blockSize != 0);
+    uint64_t offset = 0;
+    for (size_t block = 0; block < numBlocks; block++) {
+        uint64_t bits = readSize(in);
+        _blockBits.push_back(bits);
+        _blockOffsets.push_back(offset);
+        offset += (bits + 7) / 8;
+    }
+
+    _dataStart = in.tellg();
+    if (_dataStart == -1) {
+        error("The block format can only be read from a stream that can seek.");
+    }
+}
+
+size_t BlockDataReader::blockChars(size_t block) const {
+    if (block >= numBlocks()) {
+        error("There is no such block.");
+    }
+    return min(_blockSize, _size - block * _blockSize);
+}
+
+BitVector BlockDataReader::readBlockBits(size_t block) {
+    BitVector bits;
+    if (!_in.seekg(_dataStart + streamoff(_blockOffsets[block])) ||
+        !bits.readBytes(_in, _blockBits[block])) {
+        error("The block data ended in the middle of a block.");
+    }
+    return bits;
+}
+
+/* A block must decode to exactly its characters and use every one of its
+ * bits doing so.
+ */
+void BlockDataReader::decodeBlock(size_t block, const BitVector& bits, char* out) const {
+    TraceSpan decoding("decode block");
+    size_t position = 0;
+    size_t count = blockChars(block);
+    if (_decoder->decode(bits, position, out, count) != count || position != bits.size()) {
+        error("A block doesn't hold the characters its index says it does.");
+    }
+}
+
+vector<char> BlockDataReader::readBlock(size_t block) {
+    vector<char> chars(blockChars(block));
+    decodeBlock(block, readBlockBits(block), chars.data());
+    return chars;
+}
+
+/*
+ * The blocks are read from the stream in order on this thread, since a
+ * stream can only be read from one place at a time, then decoded in
+ * parallel straight into their places in the result.
+ */
+vector<char> BlockDataReader::readAll(int numThreads) {
+    vector<BitVector> blocks;
+    blocks.reserve(numBlocks());
+    for (size_t block = 0; block < numBlocks(); block++) {
+        blocks.push_back(readBlockBits(block));
+    }
+    vector<char> chars(_size);
+    forEachBlock(numBlocks(), numThreads, [&](size_t block) {
+        decodeBlock(block, blocks[block], chars.data() + block * _blockSize);
+        blocks[block] = BitVector();
+    });
+    return chars;
+}
+
+vector<char> readBlockData(istream& in, int numThreads) {
+    return BlockDataReader(in).readAll(numThreads);
+}
+
+
+STUDENT_TEST("Block data round-trips for any block size and thread count"){
+    string texts[] = {makeTestText(100000, 1), "abracadabra", "aaaa", ""};
+    size_t blockSizes[] = {1, 7, 4096, kDefaultBlockChars};
+    for (const string& text : texts){
+        for (size_t blockChars : blockSizes){
+            string oneThread;
+            for (int threads = 1; threads <= 4; threads *= 2){
+                stringstream out;
+                writeBlockData(text.data(), text.size(), out, blockChars, threads);
+                if (threads == 1){
+                    oneThread = out.str();
+                }
+                EXPECT(out.str() == oneThread);
+
+                stringstream in(out.str());
+                vector<char> chars = readBlockData(in, threads);
+                EXPECT(string(chars.begin(), chars.end()) == text);
+            }
+
+            /* Any block can be read on its own, in any order. */
+            stringstream in(oneThread);
+            BlockDataReader reader(in);
+            EXPECT_EQUAL(reader.size(), text.size());
+            EXPECT_EQUAL(reader.numBlocks(), (text.size() + blockChars - 1) / blockChars);
+            for (size_t i = 0; i < reader.numBlocks(); i += 1 + reader.numBlocks() / 20){
+                size_t block = reader.numBlocks() - 1 - i;
+                vector<char> chars = reader.readBlock(block);
+                EXPECT(string(chars.begin(), chars.end()) == text.substr(block * blockChars, blockChars));
+            }
+            EXPECT_ERROR(reader.readBlock(reader.numBlocks()));
+        }
+    }
+}
+
+STUDENT_TEST("Damaged block data is reported"){
+    string text = makeTestText(5000, 2);
+    stringstream out;
+    writeBlockData(text.data(), text.size(), out, 1000);
+    string bytes = out.str();
+
+    stringstream cut(bytes.substr(0, bytes.size() - 10));
+    EXPECT_ERROR(readBlockData(cut));
+
+    /* Flipping a bit in the middle of the last block changes how many
+     * characters it decodes to.
+     */
+    string flipped = bytes;
+    flipped[flipped.size() - 50] ^= 0x10;
+    stringstream flippedIn(flipped);
+    vector<char> chars;
+    try {
+        chars = readBlockData(flippedIn);
+    } catch (...) {
+    }
+    EXPECT(string(chars.begin(), chars.end()) != text);
+
+    stringstream notBlocks("not block data");
+    EXPECT_ERROR(readBlockData(notBlocks));
+    EXPECT_ERROR(writeBlockData(text.data(), text.size(), out, 0));
+}
@@ -0,0 +1,87 @@
+/*
+ * Block-parallel Huffman coding.
+ *
+ * writeData and readData code one long bit stream, so they run on one
+ * core. The block format cuts the message into blocks of a fixed number
+ * of characters that are coded independently with one shared tree, so
+ * blocks can be compressed and decompressed on many threads at once. An
+ * index of block sizes up front lets a reader jump straight to any block
+ * without decoding the ones before it.
+ *
+ * 4 bytes: magic number kBlockHeader
+ * 1 byte:  number of distinct characters, minus one
+ * c bytes: the leaves of the tree, in order
+ * (2c - 1 + 7) / 8 bytes: the tree bits
+ * 8 bytes: characters per block; every block but the last is full
+ * 8 bytes: total number of characters
+ * 8 bytes per block: number of message bits in the block
+ * then each block's message bits, starting on a byte boundary
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "bitvector.h"
+#include "huffmandecoder.h"
+
+/* Default number of characters in one block. */
+const size_t kDefaultBlockChars = size_t(1) << 22;
+
+/**
+ * Compresses size characters into the block format, blockChars characters
+ * per block. numThreads is the number of threads to use, counting the
+ * caller; zero or less means one per hardware thread. The bytes written
+ * are the same for any thread count.
+ */
+void writeBlockData(const char* chars, size_t size, std::ostream& out,
+                    size_t blockChars = kDefaultBlockChars, int numThreads = 0);
+
+/**
+ * Reads the block format from a stream that can seek. The constructor
+ * reads only the tree and the index.
+ */
+class BlockDataReader {
+public:
+    explicit BlockDataReader(std::istream& in);
+
+    size_t numBlocks() const {
+        return _blockBits.size();
+    }
+
+    /** Total number of characters in all the blocks. */
+    size_t size() const {
+        return _size;
+    }
+
+    /** Number of characters in the given block. */
+    size_t blockChars(size_t block) const;
+
+    /** Seeks to one block and decodes just its characters. */
+    std::vector<char> readBlock(size_t block);
+
+    /**
+     * Reads every block in order, decoding them on numThreads threads
+     * counting the caller, zero or less meaning one per hardware thread.
+     */
+    std::vector<char> readAll(int numThreads = 0);
+
+private:
+    BitVector readBlockBits(size_t block);
+    void decodeBlock(size_t block, const BitVector& bits, char* out) const;
+
+    std::istream& _in;
+    std::vector<char> _treeLeaves;
+    BitVector _treeShape;
+    size_t _blockSize;
+    size_t _size;
+    std::vector<uint64_t> _blockBits;
+    std::vector<uint64_t> _blockOffsets; // from the end of the index, in bytes
+    std::streamoff _dataStart;
+    std::unique_ptr<HuffmanTableDecoder> _decoder;
+};
+
+/** Reads all of the data in the block format. */
+std::vector<char> readBlockData(std::istream& in, int numThreads = 0);
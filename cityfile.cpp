@@ -0,0 +1,314 @@
+#include "cityfile.h"
+#include "safestpath.h"
+#include "error.h"
+#include "testing/SimpleTest.h"
+#include "testdata.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+namespace {
+    /* "CS106B CITY" */
+    const uint32_t kCityFileHeader = 0xC5106C17;
+
+    /* kCityFileHeader as a machine of the other byte order reads it. */
+    const uint32_t kSwappedCityFileHeader = 0x176C10C5;
+    const uint32_t kCityFileVersion = 1;
+    const size_t kHeaderBytes = 64;
+
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        int32_t numRows;
+        int32_t numCols;
+        uint64_t checksum;
+        uint8_t unused[40];
+    };
+    static_assert(sizeof(FileHeader) == kHeaderBytes, "The header must be 64 bytes.");
+
+    /* Where each array starts, in bytes from the start of the file. */
+    struct Layout {
+        size_t safety;
+        size_t sidewalk;
+        size_t light;
+        size_t crime;
+        size_t density;
+        size_t end;
+    };
+
+    size_t roundUpTo8(size_t bytes) {
+        return (bytes + 7) / 8 * 8;
+    }
+
+    Layout layoutFor(int numRows, int numCols) {
+        size_t cells = size_t(numRows) * numCols;
+        size_t intBytes = roundUpTo8(cells * sizeof(int32_t));
+        Layout layout;
+        layout.safety = kHeaderBytes;
+        layout.sidewalk = layout.safety + intBytes;
+        layout.light = layout.sidewalk + (cells + 63) / 64 * sizeof(uint64_t);
+        layout.crime = layout.light + intBytes;
+        layout.density = layout.crime + intBytes;
+        layout.end = layout.density + intBytes;
+        return layout;
+    }
+
+    /* Mixes every 64-bit word of the bytes, which must be a multiple of 8
+     * long. Any torn or flipped word changes the result.
+     */
+    uint64_t checksumOf(const uint8_t* bytes, size_t length) {
+        uint64_t hash = 0x9E3779B97F4A7C15ULL;
+        for (size_t i = 0; i < length; i += 8) {
+            uint64_t word;
+            memcpy(&word, bytes + i, sizeof word);
+            hash = ((hash << 5) | (hash >> 59)) ^ word;
+            hash *= 0x100000001B3ULL;
+        }
+        return hash;
+    }
+}
+
+/*
+ * The whole file is built in memory first so the checksum can go in the
+ * header, then written out in one pass.
+ */
+void writeCityFile(const Grid<street>& city, const string& filename) {
+    int numRows = city.numRows();
+    int numCols = city.numCols();
+    if (numRows < 1 || numCols < 1) {
+        error("A city file needs at least one street.");
+    }
+    Layout layout = layoutFor(numRows, numCols);
+    vector<uint8_t> contents(layout.end, 0);
+    int32_t* safety = reinterpret_cast<int32_t*>(contents.data() + layout.safety);
+    uint64_t* sidewalk = reinterpret_cast<uint64_t*>(contents.data() + layout.sidewalk);
+    int32_t* light = reinterpret_cast<int32_t*>(contents.data() + layout.light);
+    int32_t* crime = reinterpret_cast<int32_t*>(contents.data() + layout.crime);
+    int32_t* density = reinterpret_cast<int32_t*>(contents.data() + layout.density);
+    for (int row = 0; row < numRows; row++) {
+        for (int col = 0; col < numCols; col++) {
+            const street& s = city[row][col];
+            size_t i = size_t(row) * numCols + col;
+            safety[i] = s.getSafetyRating();
+            light[i] = s.getLight();
+            crime[i] = s.getCrime();
+            density[i] = s.getDensity();
+            if (s.isSidewalk()) {
+                sidewalk[i / 64] |= uint64_t(1) << (i % 64);
+            }
+        }
+    }
+
+    FileHeader header = {};
+    header.magic = kCityFileHeader;
+    header.version = kCityFileVersion;
+    header.numRows = numRows;
+    header.numCols = numCols;
+    header.checksum = checksumOf(contents.data() + kHeaderBytes, layout.end - kHeaderBytes);
+    memcpy(contents.data(), &header, sizeof header);
+
+    string partial = filename + ".partial";
+    {
+        ofstream out(partial, ios::binary | ios::trunc);
+        if (!out.write(reinterpret_cast<const char*>(contents.data()), contents.size()) || !out.flush()) {
+            error("Could not write the city file.");
+        }
+    }
+    if (rename(partial.c_str(), filename.c_str()) != 0) {
+        remove(partial.c_str());
+        error("Could not move the city file into place.");
+    }
+}
+
+MappedCity::MappedCity(const string& filename, bool verify)
+    : _mapping(nullptr),
+      _bytes(0),
+      _grid(0, 0, nullptr, nullptr),
+      _light(nullptr),
+      _crime(nullptr),
+      _density(nullptr) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error("Could not open the city file.");
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        error("Could not read the size of the city file.");
+    }
+    _bytes = size_t(info.st_size);
+    if (_bytes < kHeaderBytes) {
+        close(fd);
+        error("Chosen file is not a city file.");
+    }
+    void* mapping = mmap(nullptr, _bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        error("Could not map the city file into memory.");
+    }
+    _mapping = mapping;
+
+    /* The destructor doesn't run if the constructor fails, so unmap here. */
+    auto fail = [&](const string& message) {
+        munmap(_mapping, _bytes);
+        _mapping = nullptr;
+        error(message);
+    };
+
+    FileHeader header;
+    memcpy(&header, _mapping, sizeof header);
+    if (header.magic == kSwappedCityFileHeader) {
+        fail("The city file was written on a machine with the other byte order.");
+    }
+    if (header.magic != kCityFileHeader) {
+        fail("Chosen file is not a city file.");
+    }
+    if (header.version != kCityFileVersion) {
+        fail("The city file was written by a different version.");
+    }
+    if (header.numRows < 1 || header.numCols < 1) {
+        fail("The city file has no streets.");
+    }
+    Layout layout = layoutFor(header.numRows, header.numCols);
+    if (layout.end != _bytes) {
+        fail("The city file is the wrong size; it may have been cut short.");
+    }
+
+    const uint8_t* base = static_cast<const uint8_t*>(_mapping);
+    _grid = CityGrid(header.numRows, header.numCols,
+                     reinterpret_cast<const int32_t*>(base + layout.safety),
+                     reinterpret_cast<const uint64_t*>(base + layout.sidewalk));
+    _light = reinterpret_cast<const int32_t*>(base + layout.light);
+    _crime = reinterpret_cast<const int32_t*>(base + layout.crime);
+    _density = reinterpret_cast<const int32_t*>(base + layout.density);
+
+    if (verify && !checksumMatches()) {
+        fail("The city file is damaged; its checksum doesn't match.");
+    }
+}
+
+MappedCity::~MappedCity() {
+    if (_mapping != nullptr) {
+        munmap(_mapping, _bytes);
+    }
+}
+
+street MappedCity::streetAt(int row, int col) const {
+    if (!_grid.inBounds(row, col)) {
+        error("The street is not in the city.");
+    }
+    size_t i = _grid.index(row, col);
+    return street(_light[i], _crime[i], _density[i], _grid.isSidewalk(row, col));
+}
+
+Grid<street> MappedCity::toGrid() const {
+    Grid<street> city(numRows(), numCols());
+    for (int row = 0; row < numRows(); row++) {
+        for (int col = 0; col < numCols(); col++) {
+            city[row][col] = streetAt(row, col);
+        }
+    }
+    return city;
+}
+
+bool MappedCity::checksumMatches() const {
+    FileHeader header;
+    memcpy(&header, _mapping, sizeof header);
+    const uint8_t* base = static_cast<const uint8_t*>(_mapping);
+    return checksumOf(base + kHeaderBytes, _bytes - kHeaderBytes) == header.checksum;
+}
+
+
+STUDENT_TEST("MappedCity reads back the city that was written"){
+    const string filename = "citygrid-test.city";
+    Grid<street> city = makeTestCity(37, 70, 1);
+    writeCityFile(city, filename);
+    {
+        MappedCity mapped(filename);
+        EXPECT_EQUAL(mapped.numRows(), 37);
+        EXPECT_EQUAL(mapped.numCols(), 70);
+        CityGrid expected(city);
+        for (int row = 0; row < city.numRows(); row++){
+            for (int col = 0; col < city.numCols(); col++){
+                EXPECT_EQUAL(mapped.grid().safety(row, col), expected.safety(row, col));
+                EXPECT_EQUAL(mapped.grid().isSidewalk(row, col), expected.isSidewalk(row, col));
+                street s = mapped.streetAt(row, col);
+                EXPECT_EQUAL(s.getLight(), city[row][col].getLight());
+                EXPECT_EQUAL(s.getCrime(), city[row][col].getCrime());
+                EXPECT_EQUAL(s.getDensity(), city[row][col].getDensity());
+            }
+        }
+        EXPECT(safestRouteDP(mapped.grid()) == safestRouteDP(expected));
+        EXPECT(areEqual(safestPathDP(mapped.toGrid()), safestPathDP(city)));
+        EXPECT_ERROR(CityGrid(mapped.grid()).setStreet(0, 0, city[0][0]));
+    }
+    remove(filename.c_str());
+}
+
+STUDENT_TEST("MappedCity rejects files that aren't whole city files"){
+    const string filename = "citygrid-test.city";
+    Grid<street> city = makeTestCity(20, 30, 1);
+    writeCityFile(city, filename);
+
+    /* Flip one byte in the sidewalk flags. */
+    {
+        fstream file(filename, ios::in | ios::out | ios::binary);
+        file.seekp(64 + 20 * 30 * 4 + 5);
+        file.put(char(0x5A));
+    }
+    EXPECT_EQUAL(MappedCity(filename).numRows(), 20);
+    EXPECT_ERROR(MappedCity(filename, true).numRows());
+    EXPECT(!MappedCity(filename).checksumMatches());
+
+    /* Cut the file short. */
+    writeCityFile(city, filename);
+    {
+        ifstream in(filename, ios::binary);
+        vector<char> bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+        ofstream out(filename, ios::binary | ios::trunc);
+        out.write(bytes.data(), bytes.size() - 8);
+    }
+    EXPECT_ERROR(MappedCity(filename).numRows());
+
+    /* Written with the other byte order. */
+    writeCityFile(city, filename);
+    {
+        fstream file(filename, ios::in | ios::out | ios::binary);
+        char magic[4];
+        file.read(magic, sizeof magic);
+        reverse(magic, magic + sizeof magic);
+        file.seekp(0);
+        file.write(magic, sizeof magic);
+    }
+    EXPECT_ERROR(MappedCity(filename).numRows());
+
+    /* Not a city file at all. */
+    {
+        ofstream out(filename, ios::binary | ios::trunc);
+        out << string(200, 'x');
+    }
+    EXPECT_ERROR(MappedCity(filename).numRows());
+    remove(filename.c_str());
+    EXPECT_ERROR(MappedCity(filename).numRows());
+}
+
+STUDENT_TEST("A mapped city opened without verifying reads the same streets"){
+    const string filename = "citygrid-test.city";
+    Grid<street> city = makeTestCity(50, 60, 7);
+    writeCityFile(city, filename);
+    {
+        MappedCity mapped(filename);
+        EXPECT_EQUAL(mapped.fileBytes(), size_t(64 + 4 * 50 * 60 * 4 + 47 * 8));
+        EXPECT_EQUAL(mapped.grid().safety(49, 59), city[49][59].getSafetyRating());
+        EXPECT_EQUAL(mapped.streetAt(49, 59).getLight(), city[49][59].getLight());
+        EXPECT(mapped.checksumMatches());
+    }
+    remove(filename.c_str());
+}
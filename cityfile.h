@@ -0,0 +1,93 @@
+/*
+ * A binary city file holds a whole city laid out the way the solvers read
+ * it, so a service can start by mapping the file into memory instead of
+ * rebuilding a Grid<street> from text.
+ *
+ * Like the Huffman files in bits.cpp, the file starts with a magic number.
+ * Values are in the byte order of the machine that wrote the file, so the
+ * arrays can be read in place; a file from a machine of the other byte
+ * order is rejected when it is opened.
+ *
+ * 64-byte header:
+ *   4 bytes: magic number kCityFileHeader
+ *   4 bytes: format version
+ *   4 bytes: number of rows
+ *   4 bytes: number of columns
+ *   8 bytes: checksum of everything after the header
+ *   40 bytes: zero
+ * then, each padded to a multiple of 8 bytes, one array per attribute in
+ * row-major order:
+ *   n int32s:  safety ratings
+ *   n bits:    sidewalk flags, packed 64 to a word, lowest bit first
+ *   n int32s:  light levels
+ *   n int32s:  crime levels
+ *   n int32s:  population densities
+ *
+ * The safety and sidewalk arrays come first and are exactly what CityGrid
+ * stores, so a mapped city hands the solvers a CityGrid that reads straight
+ * from the mapped pages. The other columns are only touched when a caller
+ * wants streets back.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include "grid.h"
+#include "street.h"
+#include "citygrid.h"
+
+/**
+ * Writes the city to the given file. The file is written under a temporary
+ * name and renamed into place, so a reader never sees half of it.
+ */
+void writeCityFile(const Grid<street>& city, const std::string& filename);
+
+class MappedCity {
+public:
+    /**
+     * Maps the given city file into memory in constant time. It is an
+     * error if the file isn't a city file, was written by another version
+     * or byte order, or is the wrong size for the rows and columns in its
+     * header. The checksum reads every page of the file, so it is only
+     * checked if verify is true; checksumMatches checks it later.
+     */
+    explicit MappedCity(const std::string& filename, bool verify = false);
+    ~MappedCity();
+
+    MappedCity(const MappedCity&) = delete;
+    MappedCity& operator =(const MappedCity&) = delete;
+
+    int numRows() const {
+        return _grid.numRows();
+    }
+    int numCols() const {
+        return _grid.numCols();
+    }
+
+    /** A view of the mapped safety and sidewalk arrays, for the solvers. */
+    const CityGrid& grid() const {
+        return _grid;
+    }
+
+    /** Rebuilds the street at (row, col) from the mapped columns. */
+    street streetAt(int row, int col) const;
+
+    /** Rebuilds the whole city as a Grid<street>. */
+    Grid<street> toGrid() const;
+
+    /** Whether the contents still match the checksum in the header. */
+    bool checksumMatches() const;
+
+    size_t fileBytes() const {
+        return _bytes;
+    }
+
+private:
+    void* _mapping;
+    size_t _bytes;
+    CityGrid _grid;
+    const int32_t* _light;
+    const int32_t* _crime;
+    const int32_t* _density;
+};
@@ -0,0 +1,173 @@
+#include "citygen.h"
+#include "safestpath.h"
+#include "error.h"
+#include "testing/SimpleTest.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+using namespace std;
+
+namespace {
+    /* Scrambles the bits of x; neighbouring inputs give unrelated outputs. */
+    uint64_t mix(uint64_t x) {
+        x += 0x9E3779B97F4A7C15ULL;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        return x ^ (x >> 31);
+    }
+
+    /* The top 53 bits of bits as a number in [0, 1). */
+    double unit(uint64_t bits) {
+        return double(bits >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    bool isChance(double chance) {
+        return chance >= 0 && chance <= 1;
+    }
+}
+
+CityGenerator::CityGenerator(int numRows, int numCols, unsigned seed, const CityProfile& profile)
+    : _numRows(numRows), _numCols(numCols), _seed(mix(seed)), _profile(profile) {
+    if (numRows < 1 || numCols < 1) {
+        error("A city must have at least one row and one column.");
+    }
+    if (!isChance(profile.sidewalkChance) || !isChance(profile.badBlockChance) ||
+        !isChance(profile.badSidewalkChance) || profile.maxAttribute < 0 ||
+        !(profile.attributeSkew > 0) || profile.badBlockSize < 1) {
+        error("The city profile is out of range.");
+    }
+}
+
+uint64_t CityGenerator::hash(int row, int col, uint64_t salt) const {
+    return mix(mix(mix(_seed + uint32_t(row)) + uint32_t(col)) + salt);
+}
+
+int CityGenerator::attribute(uint64_t bits) const {
+    double u = unit(bits);
+    if (_profile.attributeSkew != 1) {
+        u = pow(u, _profile.attributeSkew);
+    }
+    return min(_profile.maxAttribute, int(u * (_profile.maxAttribute + 1)));
+}
+
+bool CityGenerator::inBadBlock(int row, int col) const {
+    int size = _profile.badBlockSize;
+    return unit(hash(row / size, col / size, 4)) < _profile.badBlockChance;
+}
+
+/* Streets in a bad block keep their random spread, squeezed into the
+ * darkest third of light and the worst third of crime.
+ */
+street CityGenerator::streetAt(int row, int col) const {
+    int light = attribute(hash(row, col, 0));
+    int crime = attribute(hash(row, col, 1));
+    int density = attribute(hash(row, col, 2));
+    double sidewalkChance = _profile.sidewalkChance;
+    if (inBadBlock(row, col)) {
+        light /= 3;
+        crime = _profile.maxAttribute - crime / 3;
+        sidewalkChance = _profile.badSidewalkChance;
+    }
+    bool sidewalk = unit(hash(row, col, 3)) < sidewalkChance;
+    if ((row == 0 && col == 0) || (row == _numRows - 1 && col == _numCols - 1)) {
+        sidewalk = true;
+    }
+    return street(light, crime, density, sidewalk);
+}
+
+Vector<street> CityGenerator::row(int row) const {
+    Vector<street> streets;
+    for (int col = 0; col < _numCols; col++) {
+        streets.add(streetAt(row, col));
+    }
+    return streets;
+}
+
+Grid<street> CityGenerator::city() const {
+    Grid<street> city(_numRows, _numCols);
+    for (int row = 0; row < _numRows; row++) {
+        for (int col = 0; col < _numCols; col++) {
+            city[row][col] = streetAt(row, col);
+        }
+    }
+    return city;
+}
+
+CityGrid CityGenerator::cityGrid() const {
+    size_t cells = size_t(_numRows) * _numCols;
+    vector<int32_t> safety(cells);
+    vector<uint64_t> sidewalk((cells + 63) / 64, 0);
+    size_t i = 0;
+    for (int row = 0; row < _numRows; row++) {
+        for (int col = 0; col < _numCols; col++, i++) {
+            street s = streetAt(row, col);
+            safety[i] = s.getSafetyRating();
+            if (s.isSidewalk()) {
+                sidewalk[i / 64] |= uint64_t(1) << (i % 64);
+            }
+        }
+    }
+    return CityGrid(_numRows, _numCols, move(safety), move(sidewalk));
+}
+
+
+STUDENT_TEST("Generated cities are repeatable in every layout"){
+    CityGenerator generator(37, 70, 5);
+    Grid<street> city = generator.city();
+    EXPECT(areEqual(streetsAlong(city, {GridLocation(3, 4), GridLocation(36, 69)}),
+                    {generator.streetAt(3, 4), generator.streetAt(36, 69)}));
+    EXPECT(areEqual(generator.row(12), CityGenerator(37, 70, 5).row(12)));
+    EXPECT(!areEqual(generator.row(12), CityGenerator(37, 70, 6).row(12)));
+
+    CityGrid fromStreets(city);
+    CityGrid direct = generator.cityGrid();
+    bool same = true;
+    for (int row = 0; row < city.numRows(); row++){
+        for (int col = 0; col < city.numCols(); col++){
+            same = same && fromStreets.safety(row, col) == direct.safety(row, col)
+                        && fromStreets.isSidewalk(row, col) == direct.isSidewalk(row, col);
+        }
+    }
+    EXPECT(same);
+    EXPECT(direct.isSidewalk(0, 0) && direct.isSidewalk(36, 69));
+    EXPECT_EQUAL(safestRouteDP(direct), safestRouteDP(fromStreets));
+}
+
+STUDENT_TEST("Generated cities follow their profile"){
+    CityProfile profile;
+    profile.sidewalkChance = 0.75;
+    profile.badBlockChance = 0.25;
+    profile.badSidewalkChance = 0.25;
+    profile.attributeSkew = 3;
+    CityGenerator generator(400, 400, 1, profile);
+
+    long sidewalks[2] = {0, 0};
+    long streets[2] = {0, 0};
+    long crime[2] = {0, 0};
+    long light = 0;
+    for (int row = 0; row < 400; row++){
+        for (int col = 0; col < 400; col++){
+            street s = generator.streetAt(row, col);
+            int bad = generator.inBadBlock(row, col);
+            streets[bad]++;
+            sidewalks[bad] += s.isSidewalk();
+            crime[bad] += s.getCrime();
+            light += bad ? 0 : s.getLight();
+            EXPECT(s.getDensity() >= 0 && s.getDensity() <= profile.maxAttribute);
+        }
+    }
+
+    /* Bad blocks are whole blocks, about a quarter of them. */
+    EXPECT(generator.inBadBlock(16, 31) == generator.inBadBlock(31, 16));
+    EXPECT(abs(double(streets[1]) / (streets[0] + streets[1]) - 0.25) < 0.05);
+    EXPECT(abs(double(sidewalks[0]) / streets[0] - 0.75) < 0.01);
+    EXPECT(abs(double(sidewalks[1]) / streets[1] - 0.25) < 0.01);
+    EXPECT(double(crime[1]) / streets[1] > 3 * double(crime[0]) / streets[0]);
+
+    /* With a skew of 3, the average is about (max + 1) / 4 rather than half. */
+    EXPECT(double(light) / streets[0] < 3.0);
+
+    profile.badBlockSize = 0;
+    EXPECT_ERROR(CityGenerator(4, 4, 1, profile));
+    EXPECT_ERROR(CityGenerator(0, 4, 1));
+}
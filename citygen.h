@@ -0,0 +1,66 @@
+/*
+ * Synthetic cities for benchmarking the solvers at any size.
+ *
+ * Every street is worked out from a hash of the seed and its location, so
+ * the same seed and profile always give the same city, and a city can be
+ * built as a Grid<street>, straight into a CityGrid, or one row at a time
+ * for the streaming solver without ever holding the rest.
+ *
+ * Light, crime and density are drawn from 0 to maxAttribute. A skew of 1
+ * draws them evenly; larger skews pile them up near zero. The city is
+ * also cut into square blocks, some of which are bad blocks: dark, high
+ * crime, and short of sidewalks, so the safest path has to steer around
+ * whole clusters of bad streets rather than single ones.
+ */
+#pragma once
+
+#include <cstdint>
+#include "grid.h"
+#include "vector.h"
+#include "street.h"
+#include "citygrid.h"
+
+struct CityProfile {
+    double sidewalkChance = 0.875;   // chance an ordinary street is a sidewalk
+    int maxAttribute = 10;           // light, crime and density run from 0 to this
+    double attributeSkew = 1.0;      // 1 is even; larger piles values near zero
+    int badBlockSize = 16;           // edge length, in streets, of a block
+    double badBlockChance = 0.05;    // chance a block is a bad block
+    double badSidewalkChance = 0.75; // chance a street in a bad block is a sidewalk
+};
+
+class CityGenerator {
+public:
+    CityGenerator(int numRows, int numCols, unsigned seed, const CityProfile& profile = CityProfile());
+
+    int numRows() const {
+        return _numRows;
+    }
+    int numCols() const {
+        return _numCols;
+    }
+
+    /** The street at the given location. The entry and exit are always sidewalks. */
+    street streetAt(int row, int col) const;
+
+    /** Whether the given location is in a bad block. */
+    bool inBadBlock(int row, int col) const;
+
+    /** The streets of one row, for feeding StreamingSolver. */
+    Vector<street> row(int row) const;
+
+    /** The whole city. */
+    Grid<street> city() const;
+
+    /** The whole city in the solvers' layout, without building its streets first. */
+    CityGrid cityGrid() const;
+
+private:
+    uint64_t hash(int row, int col, uint64_t salt) const;
+    int attribute(uint64_t bits) const;
+
+    int _numRows;
+    int _numCols;
+    uint64_t _seed;
+    CityProfile _profile;
+};
@@ -0,0 +1,128 @@
+#include "citygrid.h"
+#include "error.h"
+#include "testing/SimpleTest.h"
+using namespace std;
+
+CityGrid::CityGrid(const Grid<street>& city)
+    : _numRows(city.numRows()),
+      _numCols(city.numCols()),
+      _safety(size_t(city.numRows()) * city.numCols()),
+      _sidewalk((_safety.size() + 63) / 64, 0) {
+    for (int row = 0; row < _numRows; row++) {
+        for (int col = 0; col < _numCols; col++) {
+            const street& s = city[row][col];
+            size_t i = index(row, col);
+            _safety[i] = s.getSafetyRating();
+            if (s.isSidewalk()) {
+                _sidewalk[i / 64] |= uint64_t(1) << (i % 64);
+            }
+        }
+    }
+    pointAtOwnArrays();
+}
+
+CityGrid::CityGrid(int numRows, int numCols, const int32_t* safety, const uint64_t* sidewalk)
+    : _numRows(numRows),
+      _numCols(numCols),
+      _safetyData(safety),
+      _sidewalkData(sidewalk) {
+}
+
+CityGrid::CityGrid(int numRows, int numCols, vector<int32_t> safety, vector<uint64_t> sidewalk)
+    : _numRows(numRows),
+      _numCols(numCols),
+      _safety(move(safety)),
+      _sidewalk(move(sidewalk)) {
+    size_t cells = size_t(numRows) * numCols;
+    if (_safety.size() != cells || _sidewalk.size() != (cells + 63) / 64) {
+        error("The arrays are the wrong size for the city.");
+    }
+    pointAtOwnArrays();
+}
+
+CityGrid::CityGrid(const CityGrid& other)
+    : _numRows(other._numRows),
+      _numCols(other._numCols),
+      _safety(other._safety),
+      _sidewalk(other._sidewalk),
+      _safetyData(other._safetyData),
+      _sidewalkData(other._sidewalkData) {
+    if (!other._safety.empty()) {
+        pointAtOwnArrays();
+    }
+}
+
+CityGrid& CityGrid::operator =(const CityGrid& other) {
+    if (this != &other) {
+        _numRows = other._numRows;
+        _numCols = other._numCols;
+        _safety = other._safety;
+        _sidewalk = other._sidewalk;
+        _safetyData = other._safetyData;
+        _sidewalkData = other._sidewalkData;
+        if (!other._safety.empty()) {
+            pointAtOwnArrays();
+        }
+    }
+    return *this;
+}
+
+void CityGrid::pointAtOwnArrays() {
+    _safetyData = _safety.data();
+    _sidewalkData = _sidewalk.data();
+}
+
+void CityGrid::setStreet(int row, int col, const street& s) {
+    if (_safety.empty()) {
+        error("A view of a city can't be changed.");
+    }
+    size_t i = index(row, col);
+    _safety[i] = s.getSafetyRating();
+    if (s.isSidewalk()) {
+        _sidewalk[i / 64] |= uint64_t(1) << (i % 64);
+    } else {
+        _sidewalk[i / 64] &= ~(uint64_t(1) << (i % 64));
+    }
+}
+
+Vector<street> streetsAlong(const Grid<street>& city, const Vector<GridLocation>& route) {
+    Vector<street> path;
+    for (GridLocation loc : route) {
+        path.add(city[loc.row][loc.col]);
+    }
+    return path;
+}
+
+
+STUDENT_TEST("CityGrid matches the streets it was built from"){
+    street sdwlk =  street(2, 3,  4, false);
+    street street1 =  street(10, 1, 1, true);
+    street street3 = street(50, 1, 60, true);
+
+    /* Wider than one word of sidewalk flags. */
+    Grid<street> city(3, 70);
+    for (int row = 0; row < city.numRows(); row++){
+        for (int col = 0; col < city.numCols(); col++){
+            if ((row + col) % 3 == 0){
+                city[row][col] = sdwlk;
+            }
+            else if ((row + col) % 3 == 1){
+                city[row][col] = street1;
+            }
+            else {
+                city[row][col] = street3;
+            }
+        }
+    }
+
+    CityGrid grid(city);
+    EXPECT_EQUAL(grid.numRows(), 3);
+    EXPECT_EQUAL(grid.numCols(), 70);
+    for (int row = 0; row < city.numRows(); row++){
+        for (int col = 0; col < city.numCols(); col++){
+            EXPECT_EQUAL(grid.safety(row, col), city[row][col].getSafetyRating());
+            EXPECT_EQUAL(grid.isSidewalk(row, col), city[row][col].isSidewalk());
+        }
+    }
+    EXPECT(grid.isWalkable(0, 0));
+}
@@ -0,0 +1,108 @@
+/*
+ * CityGrid is a compact copy of a Grid<street> that the solvers in
+ * street.cpp search over. It is built once per city and then passed
+ * around by const reference, so a search never copies streets or
+ * recomputes safety ratings.
+ *
+ * Safety ratings are stored row-major in one contiguous array of int32s,
+ * and sidewalk flags are packed 64 to a word. A CityGrid can also be a
+ * view over those two arrays held somewhere else, such as a city file
+ * mapped into memory (see cityfile.h), in which case nothing is copied.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "grid.h"
+#include "vector.h"
+#include "street.h"
+
+class CityGrid {
+public:
+    /**
+     * Builds the compact layout from the given city. Every street's
+     * safety rating is computed here, exactly once.
+     */
+    explicit CityGrid(const Grid<street>& city);
+
+    /**
+     * Views safety ratings and sidewalk flags already laid out the way
+     * CityGrid stores them. The arrays are not copied and must outlive
+     * the grid and every copy of it.
+     */
+    CityGrid(int numRows, int numCols, const int32_t* safety, const uint64_t* sidewalk);
+
+    /**
+     * Takes over safety ratings and sidewalk flags already laid out the way
+     * CityGrid stores them, for loaders that decode straight into them.
+     */
+    CityGrid(int numRows, int numCols, std::vector<int32_t> safety, std::vector<uint64_t> sidewalk);
+
+    CityGrid(const CityGrid& other);
+    CityGrid& operator =(const CityGrid& other);
+
+    int numRows() const {
+        return _numRows;
+    }
+    int numCols() const {
+        return _numCols;
+    }
+    bool inBounds(int row, int col) const {
+        return row >= 0 && col >= 0 && row < _numRows && col < _numCols;
+    }
+
+    /** Position of (row, col) in the row-major arrays. */
+    size_t index(int row, int col) const {
+        return size_t(row) * _numCols + col;
+    }
+
+    int safety(int row, int col) const {
+        return _safetyData[index(row, col)];
+    }
+    bool isSidewalk(int row, int col) const {
+        size_t i = index(row, col);
+        return (_sidewalkData[i / 64] >> (i % 64)) & 1;
+    }
+
+    /**
+     * Every path starts on the entry street, so it is always walkable;
+     * any other street must be a sidewalk.
+     */
+    bool isWalkable(int row, int col) const {
+        return (row == 0 && col == 0) || isSidewalk(row, col);
+    }
+
+    /**
+     * Replaces the street at (row, col), for cities whose streets change
+     * after the grid is built. It is an error to change a view.
+     */
+    void setStreet(int row, int col, const street& s);
+
+    /** Pointer to the first safety rating of the given row. */
+    const int32_t* safetyRow(int row) const {
+        return _safetyData + index(row, 0);
+    }
+
+    /** The sidewalk flags, packed 64 to a word in row-major order. */
+    const uint64_t* sidewalkWords() const {
+        return _sidewalkData;
+    }
+
+private:
+    void pointAtOwnArrays();
+
+    int _numRows;
+    int _numCols;
+    std::vector<int32_t> _safety;    // empty for a view
+    std::vector<uint64_t> _sidewalk; // empty for a view
+    const int32_t* _safetyData;
+    const uint64_t* _sidewalkData;
+};
+
+/**
+ * Turns a path given as grid locations into the streets of the city at
+ * those locations. This is where solvers that search a CityGrid convert
+ * their answer back into the Vector<street> the rest of the code expects.
+ */
+Vector<street> streetsAlong(const Grid<street>& city, const Vector<GridLocation>& route);
@@ -0,0 +1,232 @@
+#include "huffmandecoder.h"
+#include "huffmanencoder.h"
+#include "error.h"
+#include "testing/SimpleTest.h"
+#include "testdata.h"
+#include <algorithm>
+#include <string>
+using namespace std;
+
+HuffmanTableDecoder::HuffmanTableDecoder(const BitVector& treeShape, const vector<char>& treeLeaves,
+                                         int lookupBits)
+    : _lookupBits(lookupBits) {
+    if (lookupBits < 8 || lookupBits > 12) {
+        error("Huffman lookup tables must be keyed on 8 to 12 bits.");
+    }
+    size_t shapeBit = 0;
+    size_t leaf = 0;
+    readTree(treeShape, treeLeaves, shapeBit, leaf);
+    if (shapeBit != treeShape.size() || leaf != treeLeaves.size()) {
+        error("The Huffman tree doesn't match its leaves.");
+    }
+    if (_nodes[0].zero == -1) {
+        error("A Huffman tree needs at least two leaves.");
+    }
+    buildTable();
+}
+
+HuffmanTableDecoder::HuffmanTableDecoder(const PackedEncodedData& data, int lookupBits)
+    : HuffmanTableDecoder(data.treeShape, data.treeLeaves, lookupBits) {
+}
+
+/* Rebuilds the tree from its shape: a 1 is an internal node followed by
+ * its two subtrees, a 0 is the next leaf.
+ */
+int HuffmanTableDecoder::readTree(const BitVector& treeShape, const vector<char>& treeLeaves,
+                                  size_t& shapeBit, size_t& leaf) {
+    if (shapeBit == treeShape.size() || leaf == treeLeaves.size()) {
+        error("The Huffman tree doesn't match its leaves.");
+    }
+    _nodes.push_back(Node());
+    int node = int(_nodes.size()) - 1;
+    if (!treeShape[shapeBit++]) {
+        _nodes[node].ch = treeLeaves[leaf++];
+    } else {
+        int zero = readTree(treeShape, treeLeaves, shapeBit, leaf);
+        int one = readTree(treeShape, treeLeaves, shapeBit, leaf);
+        _nodes[node].zero = zero;
+        _nodes[node].one = one;
+    }
+    return node;
+}
+
+/*
+ * Fills in the entry for every possible key by walking the tree with the
+ * key's bits, restarting at the root after each leaf.
+ */
+void HuffmanTableDecoder::buildTable() {
+    _table.assign(size_t(1) << _lookupBits, Entry());
+    for (size_t key = 0; key < _table.size(); key++) {
+        Entry& entry = _table[key];
+        entry.count = 0;
+        entry.node = 0;
+        int node = 0;
+        for (int bit = 0; bit < _lookupBits && entry.count < kSymbolsPerEntry; bit++) {
+            node = ((key >> bit) & 1) ? _nodes[node].one : _nodes[node].zero;
+            if (_nodes[node].zero == -1) {
+                entry.symbols[entry.count] = _nodes[node].ch;
+                entry.ends[entry.count] = uint8_t(bit + 1);
+                entry.count++;
+                node = 0;
+            }
+        }
+        if (entry.count == 0) {
+            entry.node = node;
+        }
+    }
+}
+
+size_t HuffmanTableDecoder::decode(const BitVector& bits, size_t& position, char* out, size_t count) const {
+    size_t size = bits.size();
+    size_t done = 0;
+    while (done < count && position < size) {
+        int node = 0;
+        if (size - position >= size_t(_lookupBits)) {
+            const Entry& entry = _table[bits.getBits(position, _lookupBits)];
+            if (entry.count > 0) {
+                size_t emit = min<size_t>(entry.count, count - done);
+                for (size_t i = 0; i < emit; i++) {
+                    out[done + i] = entry.symbols[i];
+                }
+                done += emit;
+                position += entry.ends[emit - 1];
+                continue;
+            }
+            position += _lookupBits;
+            node = entry.node;
+        }
+        /* The code is longer than a key, or too close to the end for one. */
+        while (_nodes[node].zero != -1) {
+            if (position == size) {
+                error("The message ran out of bits in the middle of a character.");
+            }
+            node = bits[position++] ? _nodes[node].one : _nodes[node].zero;
+        }
+        out[done++] = _nodes[node].ch;
+    }
+    return done;
+}
+
+vector<char> HuffmanTableDecoder::decodeAll(const PackedEncodedData& data) const {
+    vector<char> message;
+    size_t position = 0;
+    char chunk[4096];
+    while (size_t count = decode(data.messageBits, position, chunk, sizeof chunk)) {
+        message.insert(message.end(), chunk, chunk + count);
+    }
+    return message;
+}
+
+
+/* Decodes by walking the tree from the root one bit at a time. */
+static vector<char> decodeByWalking(const PackedEncodedData& data) {
+    struct WalkNode {
+        int zero = -1;
+        int one = -1;
+        char ch = 0;
+    };
+    vector<WalkNode> nodes;
+    size_t shapeBit = 0;
+    size_t leaf = 0;
+    auto readTree = [&](auto& self) -> int {
+        nodes.push_back(WalkNode());
+        int node = int(nodes.size()) - 1;
+        if (!data.treeShape[shapeBit++]) {
+            nodes[node].ch = data.treeLeaves[leaf++];
+        } else {
+            int zero = self(self);
+            int one = self(self);
+            nodes[node].zero = zero;
+            nodes[node].one = one;
+        }
+        return node;
+    };
+    readTree(readTree);
+
+    vector<char> message;
+    int node = 0;
+    for (size_t i = 0; i < data.messageBits.size(); i++){
+        node = data.messageBits[i] ? nodes[node].one : nodes[node].zero;
+        if (nodes[node].zero == -1){
+            message.push_back(nodes[node].ch);
+            node = 0;
+        }
+    }
+    return message;
+}
+
+/* Huffman-codes text the way the compressor does, with a tree built from
+ * its character counts.
+ */
+static PackedEncodedData encodeForTest(const string& text) {
+    vector<long long> counts(256, 0);
+    for (char ch : text){
+        counts[uint8_t(ch)]++;
+    }
+    HuffmanEncoder encoder(counts);
+    PackedEncodedData data;
+    encoder.writeTree(data);
+    encoder.encode(text.data(), text.size(), data.messageBits);
+    return data;
+}
+
+STUDENT_TEST("Table decoding matches walking the tree bit by bit"){
+    /* Counts that double from one character to the next make codes up to
+     * 19 bits long, longer than any lookup key.
+     */
+    string skewed;
+    for (int i = 0; i < 20; i++){
+        skewed += string(size_t(1) << i, char('a' + i));
+    }
+    string texts[] = {"ab", "abracadabra", skewed,
+                      "the safest path through the city goes right on ties"};
+    for (const string& text : texts){
+        PackedEncodedData data = encodeForTest(text);
+        vector<char> expected = decodeByWalking(data);
+        EXPECT_EQUAL(string(expected.begin(), expected.end()), text);
+        for (int lookupBits = 8; lookupBits <= 12; lookupBits++){
+            HuffmanTableDecoder decoder(data, lookupBits);
+            EXPECT(decoder.decodeAll(data) == expected);
+
+            /* Decoding a few characters at a time gives the same text. */
+            vector<char> pieces(expected.size() + 3);
+            size_t position = 0;
+            size_t done = 0;
+            while (size_t count = decoder.decode(data.messageBits, position, pieces.data() + done,
+                                                 3)){
+                done += count;
+            }
+            EXPECT_EQUAL(done, expected.size());
+            pieces.resize(done);
+            EXPECT(pieces == expected);
+            EXPECT_EQUAL(position, data.messageBits.size());
+        }
+    }
+
+    /* The rarest character ends the text, so cutting off the last bit
+     * leaves its long code unfinished.
+     */
+    PackedEncodedData data = encodeForTest(skewed + "a");
+    PackedEncodedData shorter = data;
+    shorter.messageBits = BitVector();
+    for (size_t i = 0; i + 1 < data.messageBits.size(); i++){
+        shorter.messageBits.add(data.messageBits[i]);
+    }
+    for (int lookupBits = 8; lookupBits <= 12; lookupBits++){
+        HuffmanTableDecoder decoder(data, lookupBits);
+        EXPECT_EQUAL(decoder.decodeAll(data).size(), skewed.size() + 1);
+        EXPECT_ERROR(decoder.decodeAll(shorter));
+    }
+    EXPECT_ERROR(HuffmanTableDecoder(data, 7));
+}
+
+STUDENT_TEST("Table decoding matches walking the tree on snapshot-like text"){
+    /* Mostly common characters, as in a city snapshot. Throughput on
+     * larger text is timed by the codec/tableDecode case in perfgate.
+     */
+    string text = makeTestText(100000, 3);
+    PackedEncodedData data = encodeForTest(text);
+    vector<char> byTable = HuffmanTableDecoder(data).decodeAll(data);
+    EXPECT(byTable == decodeByWalking(data));
+    EXPECT_EQUAL(string(byTable.begin(), byTable.end()), text);
+}
@@ -0,0 +1,74 @@
+/*
+ * HuffmanTableDecoder decodes Huffman-coded message bits with lookup
+ * tables instead of walking the coding tree one bit at a time.
+ *
+ * The table is indexed by the next lookupBits bits of the message (8 to 12,
+ * first bit lowest, the order BitVector keeps them in). Each entry lists
+ * every whole code that starts in those bits, up to kSymbolsPerEntry of
+ * them, and where each one ends, so one lookup usually emits several
+ * characters. When the first code is longer than lookupBits, the entry
+ * instead names the tree node those bits lead to, and the decoder walks
+ * the tree from there bit by bit. The characters decoded are always the
+ * same as walking the tree from the root.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "bitvector.h"
+#include "packeddata.h"
+
+class HuffmanTableDecoder {
+public:
+    static const int kSymbolsPerEntry = 4;
+    static const int kDefaultLookupBits = 11;
+
+    /**
+     * Builds the tables for the tree described by the given tree shape and
+     * leaves, in the order EncodedData stores them.
+     */
+    HuffmanTableDecoder(const BitVector& treeShape, const std::vector<char>& treeLeaves,
+                        int lookupBits = kDefaultLookupBits);
+
+    /** Builds the tables for the tree of the given data. */
+    explicit HuffmanTableDecoder(const PackedEncodedData& data,
+                                 int lookupBits = kDefaultLookupBits);
+
+    /**
+     * Decodes up to count characters from bits, starting at bit position,
+     * into out, moves position past them, and returns how many there were.
+     * Fewer than count means the bits ran out at the end of a code; running
+     * out in the middle of one is an error.
+     */
+    size_t decode(const BitVector& bits, size_t& position, char* out, size_t count) const;
+
+    /** Decodes every character in the message bits of data. */
+    std::vector<char> decodeAll(const PackedEncodedData& data) const;
+
+    int lookupBits() const {
+        return _lookupBits;
+    }
+
+private:
+    struct Node {
+        int32_t zero = -1; // children; a leaf has none
+        int32_t one = -1;
+        char ch = 0;
+    };
+
+    struct Entry {
+        char symbols[kSymbolsPerEntry];
+        uint8_t ends[kSymbolsPerEntry]; // bits used up to the end of each symbol
+        uint8_t count;                  // 0 if the first code is longer than the key
+        int32_t node;                   // where the walk continues when count is 0
+    };
+
+    int readTree(const BitVector& treeShape, const std::vector<char>& treeLeaves,
+                 size_t& shapeBit, size_t& leaf);
+    void buildTable();
+
+    int _lookupBits;
+    std::vector<Node> _nodes;
+    std::vector<Entry> _table;
+};
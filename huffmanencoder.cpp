@@ -0,0 +1,118 @@
+#include "huffmanencoder.h"
+#include "huffmandecoder.h"
+#include "error.h"
+#include "testing/SimpleTest.h"
+#include <functional>
+#include <queue>
+#include <string>
+#include <utility>
+using namespace std;
+
+HuffmanEncoder::HuffmanEncoder(const vector<long long>& counts) {
+    if (counts.size() != 256) {
+        error("A Huffman tree needs a count for every byte value.");
+    }
+    priority_queue<pair<long long, int>, vector<pair<long long, int>>, greater<>> forest;
+    for (int b = 0; b < 256; b++) {
+        if (counts[b] > 0) {
+            _nodes.push_back({-1, -1, char(b)});
+            forest.push({counts[b], int(_nodes.size()) - 1});
+        }
+    }
+    for (int b = 0; forest.size() < 2; b++) {
+        if (counts[b] == 0) {
+            _nodes.push_back({-1, -1, char(b)});
+            forest.push({0, int(_nodes.size()) - 1});
+        }
+    }
+    while (forest.size() > 1) {
+        auto zero = forest.top();
+        forest.pop();
+        auto one = forest.top();
+        forest.pop();
+        _nodes.push_back({zero.second, one.second, 0});
+        forest.push({zero.first + one.first, int(_nodes.size()) - 1});
+    }
+    _root = forest.top().second;
+    findCodes(_root, Code());
+}
+
+void HuffmanEncoder::writeTree(PackedEncodedData& data) const {
+    data.treeShape.clear();
+    data.treeLeaves.clear();
+    flattenTree(_root, data);
+}
+
+void HuffmanEncoder::encode(const char* chars, size_t count, BitVector& bits) const {
+    for (size_t i = 0; i < count; i++) {
+        const Code& code = _codes[uint8_t(chars[i])];
+        if (code.length == 0) {
+            error("The message has a character that isn't in the Huffman tree.");
+        }
+        bits.addBits(code.bits, code.length);
+    }
+}
+
+size_t HuffmanEncoder::encodedBits(const vector<long long>& counts) const {
+    size_t bits = 0;
+    for (int b = 0; b < 256; b++) {
+        bits += size_t(counts[b]) * _codes[b].length;
+    }
+    return bits;
+}
+
+void HuffmanEncoder::flattenTree(int node, PackedEncodedData& data) const {
+    if (_nodes[node].zero == -1) {
+        data.treeShape.add(0);
+        data.treeLeaves.push_back(_nodes[node].ch);
+    } else {
+        data.treeShape.add(1);
+        flattenTree(_nodes[node].zero, data);
+        flattenTree(_nodes[node].one, data);
+    }
+}
+
+void HuffmanEncoder::findCodes(int node, Code code) {
+    if (_nodes[node].zero == -1) {
+        _codes[uint8_t(_nodes[node].ch)] = code;
+        return;
+    }
+    if (code.length == 64) {
+        error("The Huffman tree is too deep to code.");
+    }
+    findCodes(_nodes[node].zero, {code.bits, code.length + 1});
+    findCodes(_nodes[node].one, {code.bits | (uint64_t(1) << code.length), code.length + 1});
+}
+
+
+static vector<long long> countBytes(const string& text) {
+    vector<long long> counts(256, 0);
+    for (char ch : text){
+        counts[uint8_t(ch)]++;
+    }
+    return counts;
+}
+
+STUDENT_TEST("Encoded bytes decode back to themselves"){
+    string texts[] = {"abracadabra", "aaaa", "", string("\0\xff\x80 zero and high bytes", 24)};
+    for (const string& text : texts){
+        vector<long long> counts = countBytes(text);
+        HuffmanEncoder encoder(counts);
+        PackedEncodedData data;
+        encoder.writeTree(data);
+        encoder.encode(text.data(), text.size(), data.messageBits);
+
+        /* Even one kind of byte, or none, gets a two-leaf tree. */
+        EXPECT(data.treeLeaves.size() >= 2);
+        EXPECT_EQUAL(data.treeShape.size(), data.treeLeaves.size() * 2 - 1);
+        EXPECT_EQUAL(data.messageBits.size(), encoder.encodedBits(counts));
+
+        vector<char> decoded = HuffmanTableDecoder(data).decodeAll(data);
+        EXPECT_EQUAL(string(decoded.begin(), decoded.end()), text);
+    }
+
+    HuffmanEncoder encoder(countBytes("ab"));
+    BitVector bits;
+    EXPECT_ERROR(encoder.encode("c", 1, bits));
+    EXPECT_ERROR(HuffmanEncoder(vector<long long>(10, 1)));
+}
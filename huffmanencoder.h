@@ -0,0 +1,54 @@
+/*
+ * HuffmanEncoder builds a Huffman tree from byte counts and codes bytes
+ * with it into the packed form bits.cpp reads and writes.
+ *
+ * Ties between equally frequent subtrees go to the one built first, so
+ * the same counts always give the same tree. The file formats need at
+ * least two leaves, so counts with only one nonzero byte (or none) get
+ * unused extra bytes that never appear in the message.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "bitvector.h"
+#include "packeddata.h"
+
+class HuffmanEncoder {
+public:
+    /** Builds the tree for the given counts, indexed by byte value. */
+    explicit HuffmanEncoder(const std::vector<long long>& counts);
+
+    /** Replaces the tree shape and leaves of data with this tree. */
+    void writeTree(PackedEncodedData& data) const;
+
+    /** Appends the codes of the count characters to bits. */
+    void encode(const char* chars, size_t count, BitVector& bits) const;
+
+    /** Returns how many bits encode would add for the given counts. */
+    size_t encodedBits(const std::vector<long long>& counts) const;
+
+private:
+    /* A node of the tree. Leaves have no children. */
+    struct Node {
+        int zero = -1;
+        int one = -1;
+        char ch = 0;
+    };
+
+    /* A code of up to 64 bits, first bit lowest. A Huffman code only gets
+     * longer than that for messages with more symbols than fit in memory.
+     */
+    struct Code {
+        uint64_t bits = 0;
+        int length = 0;
+    };
+
+    void flattenTree(int node, PackedEncodedData& data) const;
+    void findCodes(int node, Code code);
+
+    std::vector<Node> _nodes;
+    int _root;
+    Code _codes[256];
+};
@@ -0,0 +1,206 @@
+#include "incremental.h"
+#include "safestpath.h"
+#include "error.h"
+#include "testing/SimpleTest.h"
+#include "testdata.h"
+#include <algorithm>
+#include <climits>
+using namespace std;
+
+IncrementalSolver::IncrementalSolver(const Grid<street>& city)
+    : _city(city),
+      _grid(city),
+      _best(size_t(city.numRows()) * city.numCols(), kNoPath),
+      _goRight(_best.size(), false),
+      _changedBelow(city.numCols(), false),
+      _changedHere(city.numCols(), false) {
+    for (int row = numRows() - 1; row >= 0; row--) {
+        for (int col = numCols() - 1; col >= 0; col--) {
+            rescore(row, col);
+        }
+    }
+}
+
+/*
+ * Recomputes the score and first step of (row, col) from its neighbors,
+ * the same way safestRouteDP does, and returns whether the score changed.
+ */
+bool IncrementalSolver::rescore(int row, int col) {
+    int rows = numRows();
+    int cols = numCols();
+    size_t here = _grid.index(row, col);
+    int score = kNoPath;
+    bool goRight = false;
+    if (!_grid.isWalkable(row, col)) {
+        score = kNoPath;
+    } else if (row == rows - 1 && col == cols - 1) {
+        score = _grid.safety(row, col);
+    } else {
+        int right = (col < cols - 1) ? _best[here + 1] : kNoPath;
+        int down = (row < rows - 1) ? _best[here + cols] : kNoPath;
+        if (right != kNoPath || down != kNoPath) {
+            goRight = (right >= down);
+            score = _grid.safety(row, col) + max(right, down);
+        }
+    }
+    _goRight[here] = goRight;
+    bool changed = (score != _best[here]);
+    _best[here] = score;
+    return changed;
+}
+
+/*
+ * Rows are rescored from the changed street's row upwards, each from right
+ * to left. A street needs rescoring only if the street to its right or the
+ * street below it changed, so each row is scanned from the rightmost column
+ * that changed in the row below, and the scan stops once it is left of every
+ * such column and the street it just rescored didn't change.
+ */
+void IncrementalSolver::updateStreet(int row, int col, const street& s, SolveStats* stats) {
+    if (!_grid.inBounds(row, col)) {
+        error("The street to update is not in the city.");
+    }
+    _city[row][col] = s;
+    _grid.setStreet(row, col, s);
+
+    int cells = 0;
+    int belowLo = col;
+    int belowHi = col;
+    for (int r = row; r >= 0; r--) {
+        int hereLo = INT_MAX;
+        int hereHi = -1;
+        bool changedRight = false;
+        for (int c = belowHi; c >= 0; c--) {
+            bool dirty = changedRight || (r == row ? c == col : _changedBelow[c]);
+            if (!dirty) {
+                if (c < belowLo) break;
+                continue;
+            }
+            cells++;
+            changedRight = rescore(r, c);
+            if (changedRight) {
+                _changedHere[c] = true;
+                hereLo = min(hereLo, c);
+                hereHi = max(hereHi, c);
+            }
+        }
+
+        if (r != row) {
+            fill(_changedBelow.begin() + belowLo, _changedBelow.begin() + belowHi + 1, false);
+        }
+        swap(_changedBelow, _changedHere);
+        if (hereHi == -1) {
+            break;
+        }
+        belowLo = hereLo;
+        belowHi = hereHi;
+    }
+    if (belowHi != -1) {
+        fill(_changedBelow.begin() + belowLo, _changedBelow.begin() + belowHi + 1, false);
+    }
+    _lastUpdateCells = cells;
+    if (stats) {
+        *stats = SolveStats();
+        stats->cellsVisited = cells;
+        stats->pathsCreated = cells;
+    }
+}
+
+bool IncrementalSolver::hasPath() const {
+    return _best[0] != kNoPath;
+}
+
+int IncrementalSolver::bestSafety() const {
+    if (!hasPath()) {
+        error("There is no safe path through the city.");
+    }
+    return _best[0];
+}
+
+Vector<GridLocation> IncrementalSolver::route(SolveStats* stats) const {
+    if (!hasPath()) {
+        error("There is no safe path through the city.");
+    }
+    Vector<GridLocation> route;
+    int row = 0;
+    int col = 0;
+    route.add(GridLocation(row, col));
+    while (row != numRows() - 1 || col != numCols() - 1) {
+        if (_goRight[_grid.index(row, col)]) {
+            col++;
+        } else {
+            row++;
+        }
+        route.add(GridLocation(row, col));
+    }
+    if (stats) {
+        *stats = SolveStats();
+        stats->cellsVisited = route.size();
+        stats->pathsCreated = 1;
+        stats->bytesAllocated = route.size() * sizeof(GridLocation);
+        stats->peakFrontier = 1;
+    }
+    return route;
+}
+
+Vector<street> IncrementalSolver::path() const {
+    return streetsAlong(_city, route());
+}
+
+
+STUDENT_TEST("IncrementalSolver matches solving from scratch after each update"){
+    street sdwlk =  street(2, 3,  4, false);
+    street street1 =  street(10, 1, 1, true);
+    street street2 =  street(0, 0, 0, true);
+    street street3 = street(50, 1, 60, true);
+    Vector<street> choices = {sdwlk, street1, street2, street3};
+
+    for (unsigned seed = 1; seed <= 4; seed++){
+        Grid<street> city = makeTestCity(12, 15, seed);
+        IncrementalSolver solver(city);
+        unsigned pick = seed;
+        for (int i = 0; i < 200; i++){
+            pick = pick * 1103515245 + 12345;
+            int row = (pick >> 8) % 12;
+            int col = (pick >> 16) % 15;
+            street s = choices[(pick >> 24) % choices.size()];
+            city[row][col] = s;
+            solver.updateStreet(row, col, s);
+
+            CityGrid grid(city);
+            bool hasPath = true;
+            Vector<GridLocation> expected;
+            try {
+                expected = safestRouteDP(grid);
+            } catch (...) {
+                hasPath = false;
+            }
+            EXPECT_EQUAL(solver.hasPath(), hasPath);
+            if (hasPath){
+                EXPECT(solver.route() == expected);
+                EXPECT_EQUAL(solver.bestSafety(), getPathSafetyVector(streetsAlong(city, expected)));
+            }
+        }
+    }
+}
+
+STUDENT_TEST("IncrementalSolver only rescores streets above and left of a change"){
+    Grid<street> city = makeTestCity(500, 500, 4);
+    IncrementalSolver solver(city);
+
+    /* Nothing depends on the entry, so only it is rescored. */
+    solver.updateStreet(0, 0, street(50, 1, 60, true));
+    EXPECT_EQUAL(solver.lastUpdateCells(), 1);
+
+    /* A change near the entry can only reach a handful of streets. */
+    solver.updateStreet(3, 4, street(50, 1, 60, true));
+    EXPECT(solver.lastUpdateCells() <= 4 * 5);
+
+    /* Setting a street to what it already is stops right away. */
+    solver.updateStreet(250, 250, city[250][250]);
+    EXPECT_EQUAL(solver.lastUpdateCells(), 1);
+
+    TIME_OPERATION(250000, IncrementalSolver(city).hasPath());
+    TIME_OPERATION(1, solver.updateStreet(10, 10, street(0, 0, 0, true)));
+    TIME_OPERATION(1, solver.updateStreet(499, 499, street(10, 1, 1, true)));
+}
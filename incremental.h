@@ -0,0 +1,83 @@
+/*
+ * IncrementalSolver keeps the safest right/down path through a city up to
+ * date while individual streets change, such as a broken streetlight or a
+ * new crime report.
+ *
+ * It keeps the same tables as safestRouteDP: the best safety rating from
+ * every street to the exit and whether that path steps right or down
+ * first. A street's score only depends on the streets below and to the
+ * right of it, so a change can only affect streets above and to the left.
+ * An update rescores those row by row, moving up from the changed street,
+ * and stops as soon as a whole row comes out unchanged.
+ */
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "grid.h"
+#include "vector.h"
+#include "street.h"
+#include "citygrid.h"
+#include "solvestats.h"
+
+class IncrementalSolver {
+public:
+    /** Solves the city from scratch. */
+    explicit IncrementalSolver(const Grid<street>& city);
+
+    int numRows() const {
+        return _grid.numRows();
+    }
+    int numCols() const {
+        return _grid.numCols();
+    }
+
+    /** The city as it is after every update so far. */
+    const Grid<street>& city() const {
+        return _city;
+    }
+
+    /**
+     * Replaces the street at (row, col) and rescores only the streets whose
+     * best path could have changed. The cost is proportional to the number
+     * of streets whose score actually changes, plus their neighbors.
+     * If stats isn't null, it is filled in with the streets rescored.
+     */
+    void updateStreet(int row, int col, const street& s, SolveStats* stats = nullptr);
+
+    /** Whether there is currently any path from the entry to the exit. */
+    bool hasPath() const;
+
+    /** Safety rating of the current safest path. */
+    int bestSafety() const;
+
+    /**
+     * Locations of the current safest path; the same as safestRouteDP.
+     * If stats isn't null, it is filled in with the streets the path
+     * follows and the memory it takes.
+     */
+    Vector<GridLocation> route(SolveStats* stats = nullptr) const;
+
+    /** Streets of the current safest path. */
+    Vector<street> path() const;
+
+    /** Number of streets rescored by the last call to updateStreet. */
+    int lastUpdateCells() const {
+        return _lastUpdateCells;
+    }
+
+private:
+    bool rescore(int row, int col);
+
+    Grid<street> _city;
+    CityGrid _grid;
+    std::vector<int32_t> _best;
+    std::vector<char> _goRight;
+
+    /* Which columns changed in the row just rescored, and in the row being
+     * rescored now. Only the touched range is ever cleared.
+     */
+    std::vector<char> _changedBelow;
+    std::vector<char> _changedHere;
+    int _lastUpdateCells = 0;
+};
@@ -0,0 +1,111 @@
+/*
+ * PackedEncodedData holds the same Huffman-coded data as EncodedData from
+ * bits.h, but keeps the tree shape and message bits in BitVectors instead
+ * of a Queue<Bit>, one heap node per bit. A compressed file in memory then
+ * takes about as many bytes as it does on disk.
+ *
+ * Everything here is implemented in bits.cpp next to writeData and
+ * readData. writePackedData and readPackedData use exactly the same file
+ * format as those, so either pair can read what the other wrote.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "bits.h"
+#include "bitvector.h"
+
+struct PackedEncodedData {
+    BitVector treeShape;
+    std::vector<char> treeLeaves;
+    BitVector messageBits;
+};
+
+/** Writes the data to the stream in the writeData format. */
+void writePackedData(const PackedEncodedData& data, std::ostream& out);
+
+/**
+ * Reads data in the writeData format. The message bits are read from the
+ * stream into their BitVector in a single call. A stream that can't seek,
+ * like a pipe, is read with readFramedData instead.
+ */
+PackedEncodedData readPackedData(std::istream& in);
+
+/** Moves the bits out of data's queues into packed form, emptying data. */
+PackedEncodedData packData(EncodedData& data);
+
+/** Copies packed data back out into queues. */
+EncodedData unpackData(const PackedEncodedData& data);
+
+/*
+ * The framed format is for data that has to be decoded as it arrives, such
+ * as from a pipe or socket, where readData can't seek ahead to find out how
+ * long the message is. The message bits are cut into frames that each say
+ * how many bits they hold:
+ *
+ * 4 bytes: magic number kFramedHeader
+ * 1 byte:  number of distinct characters, minus one
+ * c bytes: the leaves of the tree, in order
+ * (2c - 1 + 7) / 8 bytes: the tree bits
+ * then any number of frames, each:
+ *   4 bytes: number of message bits n in the frame, at least one
+ *   (n + 7) / 8 bytes: the message bits
+ * 4 bytes: zero, marking the end
+ *
+ * A missing end marker means the stream was cut short.
+ */
+const size_t kDefaultFrameBits = size_t(1) << 20;
+
+/** Writes the data in the framed format, at most frameBits message bits per frame. */
+void writeFramedData(const PackedEncodedData& data, std::ostream& out,
+                     size_t frameBits = kDefaultFrameBits);
+
+/**
+ * Reads Huffman-coded data a block at a time without ever seeking, so it
+ * works on pipes. It reads the framed format, and also the writeData
+ * format, whose bits it hands out in blocks as they arrive while holding
+ * back the last byte until the end of the stream shows how much of it is
+ * used. Either way, memory is bounded by the size of one block.
+ */
+class FramedDataReader {
+public:
+    /** Reads the header and the tree from the stream. */
+    explicit FramedDataReader(std::istream& in);
+
+    /** Reads the tree from a stream whose header has already been read. */
+    FramedDataReader(std::istream& in, uint32_t header);
+
+    const BitVector& treeShape() const {
+        return _treeShape;
+    }
+    const std::vector<char>& treeLeaves() const {
+        return _treeLeaves;
+    }
+
+    /**
+     * Replaces bits with the next block of message bits and returns true,
+     * or returns false once every message bit has been handed out.
+     */
+    bool nextBlock(BitVector& bits);
+
+private:
+    bool readUnframedBytes(BitVector& bits);
+
+    std::istream& _in;
+    bool _framed;
+    bool _done = false;
+    BitVector _treeShape;
+    std::vector<char> _treeLeaves;
+
+    /* Only used for the writeData format. */
+    BitVector _leftover;
+    std::vector<char> _buffer;
+    char _held = 0;
+    bool _hasHeld = false;
+    int _modulus = 8;
+};
+
+/** Reads all of the data with a FramedDataReader, in either format. */
+PackedEncodedData readFramedData(std::istream& in);
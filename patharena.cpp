@@ -0,0 +1,79 @@
+#include "patharena.h"
+#include "error.h"
+#include "testing/SimpleTest.h"
+#include <algorithm>
+#include <climits>
+using namespace std;
+
+namespace {
+    const size_t kFirstNodes = 1024;
+}
+
+void PathArena::grow() {
+    if (_nodes.size() >= size_t(INT32_MAX)) {
+        error("The search made too many paths to index.");
+    }
+    _nodes.resize(min(size_t(INT32_MAX), max(kFirstNodes, 2 * _nodes.size())));
+    _growths++;
+}
+
+Vector<GridLocation> PathArena::route(int32_t node) const {
+    int length = 0;
+    for (int32_t at = node; at != kNoParent; at = _nodes[at].parent) {
+        length++;
+    }
+    Vector<GridLocation> route(length);
+    for (int32_t at = node; at != kNoParent; at = _nodes[at].parent) {
+        route[--length] = GridLocation(_nodes[at].row, _nodes[at].col);
+    }
+    return route;
+}
+
+
+STUDENT_TEST("PathArena shares prefixes and spells out one path"){
+    PathArena arena;
+    int32_t entry = arena.add(kNoParent, 0, 0, 5);
+    int32_t right = arena.add(entry, 0, 1, 5 + 3);
+    int32_t down = arena.add(entry, 1, 0, 5 + 7);
+    int32_t corner = arena.add(down, 1, 1, 5 + 7 + 2);
+
+    EXPECT_EQUAL(arena.size(), 4);
+    EXPECT_EQUAL(arena[right].parent, entry);
+    EXPECT_EQUAL(arena[corner].safety, 14);
+    Vector<GridLocation> expected = {GridLocation(0, 0), GridLocation(1, 0), GridLocation(1, 1)};
+    EXPECT_EQUAL(arena.route(corner), expected);
+    EXPECT_EQUAL(arena.route(entry).size(), 1);
+}
+
+STUDENT_TEST("PathArena keeps indices across growth and memory across resets"){
+    PathArena arena;
+    int32_t last = kNoParent;
+    for (int i = 0; i < 5000; i++){
+        last = arena.add(last, i, 0, i);
+    }
+    Vector<GridLocation> route = arena.route(last);
+    EXPECT_EQUAL(route.size(), 5000);
+    EXPECT_EQUAL(route[4321], GridLocation(4321, 0));
+    EXPECT(arena.growths() >= 1);
+
+    size_t bytes = arena.capacityBytes();
+    EXPECT(bytes >= 5000 * sizeof(PathNode));
+    arena.reset();
+    EXPECT_EQUAL(arena.size(), 0);
+    EXPECT_EQUAL(arena.add(kNoParent, 2, 3, 4), 0);
+    EXPECT_EQUAL(arena.capacityBytes(), bytes);
+}
+
+STUDENT_TEST("PathArena moves a node onto a safer parent"){
+    PathArena arena;
+    int32_t entry = arena.add(kNoParent, 0, 0, 5);
+    int32_t right = arena.add(entry, 0, 1, 5 + 3);
+    int32_t down = arena.add(entry, 1, 0, 5 + 7);
+    int32_t corner = arena.add(right, 1, 1, 5 + 3 + 2);
+
+    arena.reparent(corner, down, 5 + 7 + 2);
+    EXPECT_EQUAL(arena.size(), 4);
+    EXPECT_EQUAL(arena[corner].safety, 14);
+    Vector<GridLocation> expected = {GridLocation(0, 0), GridLocation(1, 0), GridLocation(1, 1)};
+    EXPECT_EQUAL(arena.route(corner), expected);
+}
@@ -0,0 +1,80 @@
+/*
+ * PathArena holds the paths of a breadth-first search as a tree of nodes.
+ * A node stores only its last street, the index of the node it extends
+ * and the safety of the path so far, so extending a path is O(1) and
+ * scoring it is free. Every path shares the nodes of the path it grew
+ * from, and only the path that is handed back is ever spelled out.
+ *
+ * Nodes are bump-allocated from one array, in the order they are added,
+ * so the array doubles as the search's FIFO queue. A node that has not
+ * been taken off the queue yet can be moved onto a safer parent with
+ * reparent(). reset() is O(1) and keeps the array, so an arena reused
+ * across searches stops allocating once it has grown to fit the largest one.
+ */
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "grid.h"
+#include "vector.h"
+
+struct PathNode {
+    int32_t parent; // index of the node this path extends, or kNoParent
+    int32_t row;
+    int32_t col;
+    int32_t safety; // safety of the whole path up to and including this street
+};
+
+const int32_t kNoParent = -1;
+
+class PathArena {
+public:
+    /** Forgets every node, keeping their memory for the next search. */
+    void reset() {
+        _used = 0;
+    }
+
+    /** Adds the path that extends parent by one street and returns its index. */
+    int32_t add(int32_t parent, int row, int col, int32_t safety) {
+        if (size_t(_used) == _nodes.size()) {
+            grow();
+        }
+        _nodes[_used] = {parent, row, col, safety};
+        return _used++;
+    }
+
+    /** Makes the node at index extend a different parent, with the given safety. */
+    void reparent(int32_t index, int32_t parent, int32_t safety) {
+        _nodes[index].parent = parent;
+        _nodes[index].safety = safety;
+    }
+
+    const PathNode& operator [](int32_t index) const {
+        return _nodes[index];
+    }
+
+    /** Number of nodes added since the last reset. */
+    int32_t size() const {
+        return _used;
+    }
+
+    /** Bytes of nodes the arena is holding on to, used or not. */
+    size_t capacityBytes() const {
+        return _nodes.size() * sizeof(PathNode);
+    }
+
+    /** Number of times the arena has had to allocate a bigger array. */
+    int growths() const {
+        return _growths;
+    }
+
+    /** The locations of the path ending at the given node, first street first. */
+    Vector<GridLocation> route(int32_t node) const;
+
+private:
+    void grow();
+
+    std::vector<PathNode> _nodes;
+    int32_t _used = 0;
+    int _growths = 0;
+};
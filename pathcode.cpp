@@ -0,0 +1,174 @@
+#include "pathcode.h"
+#include "citygrid.h"
+#include "safestpath.h"
+#include "error.h"
+#include "testing/SimpleTest.h"
+#include "testdata.h"
+#include <vector>
+using namespace std;
+
+namespace {
+    const int kMovesPerWord = 64;
+}
+
+PathCode::PathCode()
+    : _start(0, 0) {
+}
+
+PathCode::PathCode(GridLocation start)
+    : _start(start) {
+}
+
+PathCode::PathCode(const Vector<GridLocation>& route) {
+    if (route.isEmpty()) {
+        error("A path must have at least one street.");
+    }
+    _start = route[0];
+    for (int i = 1; i < route.size(); i++) {
+        GridLocation from = route[i - 1];
+        GridLocation to = route[i];
+        if (to.row == from.row && to.col == from.col + 1) {
+            addRight();
+        } else if (to.row == from.row + 1 && to.col == from.col) {
+            addDown();
+        } else {
+            error("Every step of a path must go right or down one street.");
+        }
+    }
+}
+
+void PathCode::add(bool down) {
+    int bit = _numMoves % kMovesPerWord;
+    if (down) {
+        _tail |= uint64_t(1) << bit;
+        _numDowns++;
+    }
+    _numMoves++;
+    if (bit == kMovesPerWord - 1) {
+        _full = make_shared<const Block>(Block{_full, _tail});
+        _tail = 0;
+    }
+}
+
+Vector<GridLocation> PathCode::locations() const {
+    vector<uint64_t> words;
+    for (const Block* block = _full.get(); block != nullptr; block = block->previous.get()) {
+        words.push_back(block->moves);
+    }
+
+    Vector<GridLocation> route;
+    GridLocation here = _start;
+    route.add(here);
+    for (int i = 0; i < _numMoves; i++) {
+        size_t word = i / kMovesPerWord;
+        uint64_t moves = (word < words.size()) ? words[words.size() - 1 - word] : _tail;
+        if ((moves >> (i % kMovesPerWord)) & 1) {
+            here.row++;
+        } else {
+            here.col++;
+        }
+        route.add(here);
+    }
+    return route;
+}
+
+Vector<street> PathCode::streets(const Grid<street>& city) const {
+    Vector<street> path;
+    for (GridLocation loc : locations()) {
+        path.add(city[loc.row][loc.col]);
+    }
+    return path;
+}
+
+/*
+ * Compares the unfilled words first, then the filled ones from the latest
+ * back. Once both chains reach the same shared block, the rest of the
+ * moves are the same without looking at them.
+ */
+bool PathCode::operator ==(const PathCode& other) const {
+    if (_start != other._start || _numMoves != other._numMoves
+            || _numDowns != other._numDowns || _tail != other._tail) {
+        return false;
+    }
+    const Block* lhs = _full.get();
+    const Block* rhs = other._full.get();
+    while (lhs != rhs) {
+        if (lhs->moves != rhs->moves) {
+            return false;
+        }
+        lhs = lhs->previous.get();
+        rhs = rhs->previous.get();
+    }
+    return true;
+}
+
+
+STUDENT_TEST("PathCode round-trips routes and shares prefixes"){
+    /* A path long enough to fill a few words, zig-zagging right and down. */
+    Vector<GridLocation> route = {GridLocation(2, 3)};
+    for (int i = 0; i < 200; i++){
+        GridLocation last = route[route.size() - 1];
+        bool down = (i * 7 % 5) < 2;
+        route.add(down ? GridLocation(last.row + 1, last.col) : GridLocation(last.row, last.col + 1));
+    }
+    PathCode code(route);
+    EXPECT_EQUAL(code.numMoves(), 200);
+    EXPECT(code.start() == GridLocation(2, 3));
+    EXPECT(code.end() == route[route.size() - 1]);
+    EXPECT(code.locations() == route);
+
+    /* Two paths extended from one copy share its words, and only differ
+     * once their moves do.
+     */
+    PathCode right = code;
+    PathCode down = code;
+    EXPECT(right == down);
+    right.addRight();
+    down.addDown();
+    EXPECT(right != down);
+    down = code;
+    down.addRight();
+    EXPECT(right == down);
+    EXPECT(code.locations() == route);
+
+    Vector<GridLocation> backward;
+    code.forEachLocationBackward([&](GridLocation loc) {
+        backward.insert(0, loc);
+    });
+    EXPECT(backward == route);
+
+    EXPECT(PathCode(GridLocation(0, 1)) != PathCode());
+    EXPECT_ERROR(PathCode(Vector<GridLocation>{GridLocation(0, 0), GridLocation(1, 1)}));
+}
+
+STUDENT_TEST("PathCode expands to the streets of a city"){
+    Grid<street> city = makeTestCity(3, 4, 2);
+    PathCode code;
+    code.addRight();
+    code.addDown();
+    code.addRight();
+    code.addDown();
+    code.addRight();
+    Vector<street> streets = code.streets(city);
+    EXPECT_EQUAL(streets.size(), 6);
+    EXPECT_EQUAL(streets[2].getSafetyRating(), city[1][1].getSafetyRating());
+    EXPECT_EQUAL(streets[5].getSafetyRating(), city[2][3].getSafetyRating());
+    EXPECT_EQUAL(getPathSafetyVector(code, CityGrid(city)), getPathSafetyVector(streets));
+
+    /* Built separately over many words, so comparing them has to look at
+     * every word, and a change to the last move is seen.
+     */
+    PathCode longPath;
+    PathCode sameMoves;
+    PathCode lastDiffers;
+    for (int i = 0; i < 5000; i++){
+        longPath.add(i % 3 == 0);
+        sameMoves.add(i % 3 == 0);
+        lastDiffers.add(i == 4999 ? i % 3 != 0 : i % 3 == 0);
+    }
+    EXPECT(longPath == sameMoves);
+    EXPECT(longPath != lastDiffers);
+    Vector<GridLocation> locations = longPath.locations();
+    EXPECT_EQUAL(locations.size(), 5001);
+    EXPECT_EQUAL(locations[5000], GridLocation(1667, 3333));
+}
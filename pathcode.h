@@ -0,0 +1,103 @@
+/*
+ * PathCode stores a right/down path through a city as its starting street
+ * plus one bit per move (0 = right, 1 = down) instead of a Vector of
+ * streets. Moves are packed 64 to a word, lowest bit first. Filled words
+ * are kept in an immutable shared chain, so copying a PathCode is O(1) and
+ * a path and every path extended from it share the moves they have in
+ * common. Adding a move is O(1), allocating one word for every 64 moves.
+ *
+ * A path is only expanded to streets or locations when it is handed back
+ * to the caller, and two paths are compared a word at a time.
+ */
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include "grid.h"
+#include "vector.h"
+#include "street.h"
+
+class PathCode {
+public:
+    /** An empty path starting at (0, 0). */
+    PathCode();
+
+    /** An empty path starting at the given street. */
+    explicit PathCode(GridLocation start);
+
+    /**
+     * The path through the given locations. It is an error if a location
+     * isn't one step right or down from the one before it.
+     */
+    explicit PathCode(const Vector<GridLocation>& route);
+
+    GridLocation start() const {
+        return _start;
+    }
+
+    /** The street the path ends on. */
+    GridLocation end() const {
+        return GridLocation(_start.row + _numDowns, _start.col + _numMoves - _numDowns);
+    }
+
+    int numMoves() const {
+        return _numMoves;
+    }
+
+    /** Extends the path by one move right, or down if down is true. */
+    void add(bool down);
+    void addRight() {
+        add(false);
+    }
+    void addDown() {
+        add(true);
+    }
+
+    /** The locations along the path, starting with the start. */
+    Vector<GridLocation> locations() const;
+
+    /** The streets along the path, starting with the start. */
+    Vector<street> streets(const Grid<street>& city) const;
+
+    /**
+     * Calls visit with every location along the path, from the end back
+     * to the start. The moves are read in place, so nothing is allocated.
+     */
+    template <typename Visit>
+    void forEachLocationBackward(Visit visit) const {
+        GridLocation here = end();
+        visit(here);
+        auto stepBack = [&](uint64_t moves, int count) {
+            for (int bit = count - 1; bit >= 0; bit--) {
+                if ((moves >> bit) & 1) {
+                    here.row--;
+                } else {
+                    here.col--;
+                }
+                visit(here);
+            }
+        };
+        stepBack(_tail, _numMoves % 64);
+        for (const Block* block = _full.get(); block != nullptr; block = block->previous.get()) {
+            stepBack(block->moves, 64);
+        }
+    }
+
+    /** Whether both paths start at the same street and make the same moves. */
+    bool operator ==(const PathCode& other) const;
+    bool operator !=(const PathCode& other) const {
+        return !(*this == other);
+    }
+
+private:
+    struct Block {
+        std::shared_ptr<const Block> previous;
+        uint64_t moves;
+    };
+
+    std::shared_ptr<const Block> _full; // filled words, latest first
+    uint64_t _tail = 0;                 // moves after the filled words
+    int _numMoves = 0;
+    int _numDowns = 0;
+    GridLocation _start;
+};
@@ -0,0 +1,268 @@
+#include "pathcursor.h"
+#include "safestpath.h"
+#include "error.h"
+#include "testing/SimpleTest.h"
+#include "testdata.h"
+#include <algorithm>
+using namespace std;
+
+PathCursor::PathCursor(const CityGrid& grid)
+    : _grid(grid),
+      _index(grid),
+      _numRows(grid.numRows()),
+      _numCols(grid.numCols()),
+      _bestSafety(0) {
+    if (size_t(_numRows) * _numCols > size_t(INT32_MAX)) {
+        error("The city is too large to enumerate paths over.");
+    }
+    if (_index.canReach(0, 0)) {
+        _bestSafety = _index.bestSafety(0, 0);
+    }
+}
+
+bool PathCursor::hasNext() const {
+    return _index.canReach(0, 0) && (!_handedOutBest || !_frontier.empty());
+}
+
+/* The street after cell on the safest path from cell. */
+int32_t PathCursor::nextOnBest(int32_t cell) const {
+    int row = cell / _numCols;
+    int col = cell % _numCols;
+    return _index.stepsDown(row, col) ? cell + _numCols : cell + 1;
+}
+
+/*
+ * The street the other move from cell leads to, or -1 if that move can't
+ * reach the destination.
+ */
+int32_t PathCursor::sidetrackTarget(int32_t cell) const {
+    if (isDestination(cell)) {
+        return -1;
+    }
+    int row = cell / _numCols;
+    int col = cell % _numCols;
+    if (_index.stepsDown(row, col)) {
+        col++;
+    } else {
+        row++;
+    }
+    if (row >= _numRows || col >= _numCols || !_grid.isSidewalk(row, col)
+            || !_index.canReach(row, col)) {
+        return -1;
+    }
+    return int32_t(index(row, col));
+}
+
+/*
+ * Returns the heap of sidetracks along the safest path from cell, building
+ * it for cell and every street after it on that path that doesn't have one
+ * yet. Each street's heap is the next street's heap plus its own sidetrack.
+ */
+int32_t PathCursor::sidetrackHeap(int32_t cell) {
+    vector<int32_t> unbuilt;
+    int32_t heap = -1;
+    for (int32_t c = cell; ; c = nextOnBest(c)) {
+        auto found = _heapOf.find(c);
+        if (found != _heapOf.end()) {
+            heap = found->second;
+            break;
+        }
+        unbuilt.push_back(c);
+        if (isDestination(c)) {
+            break;
+        }
+    }
+    for (int i = int(unbuilt.size()) - 1; i >= 0; i--) {
+        int32_t c = unbuilt[i];
+        int32_t target = sidetrackTarget(c);
+        if (target != -1) {
+            int row = c / _numCols;
+            int col = c % _numCols;
+            int loss = _index.bestSafety(row, col) - _grid.safety(row, col)
+                       - _index.bestSafety(target / _numCols, target % _numCols);
+            heap = insert(heap, loss, c);
+        }
+        _heapOf[c] = heap;
+    }
+    return heap;
+}
+
+int32_t PathCursor::insert(int32_t heap, int loss, int32_t cell) {
+    _nodes.push_back({loss, cell, -1, -1, 1});
+    return merge(int32_t(_nodes.size()) - 1, heap);
+}
+
+/*
+ * Merges two leftist heaps without changing either: only the nodes along
+ * the merged right spine are copied, so it costs O(log size).
+ */
+int32_t PathCursor::merge(int32_t lhs, int32_t rhs) {
+    if (lhs == -1) return rhs;
+    if (rhs == -1) return lhs;
+    if (_nodes[rhs].loss < _nodes[lhs].loss
+            || (_nodes[rhs].loss == _nodes[lhs].loss && _nodes[rhs].cell < _nodes[lhs].cell)) {
+        swap(lhs, rhs);
+    }
+    HeapNode copy = _nodes[lhs];
+    copy.right = merge(copy.right, rhs);
+    int leftRank = (copy.left == -1) ? 0 : _nodes[copy.left].rank;
+    int rightRank = (copy.right == -1) ? 0 : _nodes[copy.right].rank;
+    if (leftRank < rightRank) {
+        swap(copy.left, copy.right);
+    }
+    copy.rank = min(leftRank, rightRank) + 1;
+    _nodes.push_back(copy);
+    return int32_t(_nodes.size()) - 1;
+}
+
+void PathCursor::push(long long loss, int32_t node, int32_t parent) {
+    _candidates.push_back({node, parent});
+    _frontier.push({loss, int32_t(_candidates.size()) - 1});
+}
+
+/*
+ * The first call hands out the safest path. After that, each call pops the
+ * candidate with the least total loss and pushes its successors: the same
+ * sidetracks with the last one swapped for either child of its heap node,
+ * which loses at least as much, and the same sidetracks plus the cheapest
+ * sidetrack after the last one. Every set of sidetracks is reached exactly
+ * once this way, and never before a set that loses less.
+ */
+Vector<GridLocation> PathCursor::next(SolveStats* stats) {
+    if (!hasNext()) {
+        error("There are no more paths through the city.");
+    }
+    size_t nodesBefore = _nodes.size();
+    size_t candidatesBefore = _candidates.size();
+    bool popped = _handedOutBest;
+    long long loss = 0;
+    vector<int32_t> sidetracks;
+    if (!_handedOutBest) {
+        _handedOutBest = true;
+        int32_t root = sidetrackHeap(0);
+        if (root != -1) {
+            push(_nodes[root].loss, root, -1);
+        }
+    } else {
+        Entry top = _frontier.top();
+        _frontier.pop();
+        loss = top.loss;
+        Candidate chosen = _candidates[top.candidate];
+        HeapNode node = _nodes[chosen.node];
+
+        long long withoutLast = loss - node.loss;
+        if (node.left != -1) {
+            push(withoutLast + _nodes[node.left].loss, node.left, chosen.parent);
+        }
+        if (node.right != -1) {
+            push(withoutLast + _nodes[node.right].loss, node.right, chosen.parent);
+        }
+        int32_t after = sidetrackHeap(sidetrackTarget(node.cell));
+        if (after != -1) {
+            push(loss + _nodes[after].loss, after, top.candidate);
+        }
+
+        for (int32_t c = top.candidate; c != -1; c = _candidates[c].parent) {
+            sidetracks.push_back(_nodes[_candidates[c].node].cell);
+        }
+        reverse(sidetracks.begin(), sidetracks.end());
+    }
+
+    Vector<GridLocation> route;
+    int32_t cell = 0;
+    route.add(GridLocation(0, 0));
+    for (int32_t sidetrack : sidetracks) {
+        while (cell != sidetrack) {
+            cell = nextOnBest(cell);
+            route.add(GridLocation(cell / _numCols, cell % _numCols));
+        }
+        cell = sidetrackTarget(cell);
+        route.add(GridLocation(cell / _numCols, cell % _numCols));
+    }
+    while (!isDestination(cell)) {
+        cell = nextOnBest(cell);
+        route.add(GridLocation(cell / _numCols, cell % _numCols));
+    }
+
+    _lastSafety = int(_bestSafety - loss);
+    _pathsPulled++;
+    if (stats) {
+        long long pushed = _candidates.size() - candidatesBefore;
+        *stats = SolveStats();
+        stats->cellsVisited = route.size();
+        stats->pathsCreated = pushed;
+        stats->queuePushes = pushed;
+        stats->queuePops = popped ? 1 : 0;
+        stats->bytesAllocated = (_nodes.size() - nodesBefore) * sizeof(HeapNode)
+                                + pushed * sizeof(Candidate) + route.size() * sizeof(GridLocation);
+        stats->peakFrontier = _frontier.size() + stats->queuePops;
+    }
+    return route;
+}
+
+
+STUDENT_TEST("PathCursor hands out every path, safest first"){
+    for (unsigned seed = 1; seed <= 6; seed++){
+        Grid<street> city = makeTestCity(5, 6, seed);
+        CityGrid grid(city);
+        Vector<Vector<GridLocation>> expected = safestRoutesTopK(grid, 200);
+
+        PathCursor cursor(grid);
+        Vector<Vector<GridLocation>> pulled;
+        while (cursor.hasNext()){
+            Vector<GridLocation> route = cursor.next();
+            EXPECT_EQUAL(cursor.lastSafety(), getPathSafetyVector(streetsAlong(city, route)));
+            if (pulled.isEmpty()){
+                EXPECT(route == safestRouteDP(grid));
+            }
+            pulled.add(route);
+        }
+        EXPECT_EQUAL(cursor.pathsPulled(), expected.size());
+        EXPECT_ERROR(cursor.next());
+
+        /* Paths with the same rating may come out in a different order than
+         * safestRoutesTopK gives, but the ratings must line up one for one,
+         * and every path must be one of the city's paths, handed out once.
+         */
+        for (int i = 0; i < pulled.size(); i++){
+            EXPECT_EQUAL(getPathSafetyVector(streetsAlong(city, pulled[i])),
+                         getPathSafetyVector(streetsAlong(city, expected[i])));
+            int matches = 0;
+            for (const Vector<GridLocation>& route : expected){
+                if (route == pulled[i]) matches++;
+            }
+            EXPECT_EQUAL(matches, 1);
+            for (int j = 0; j < i; j++){
+                EXPECT(!(pulled[j] == pulled[i]));
+            }
+        }
+    }
+}
+
+STUDENT_TEST("PathCursor with no path through the city"){
+    street sdwlk =  street(2, 3,  4, false);
+    street street2 =  street(0, 0, 0, true);
+    Grid<street> city = {{street2, sdwlk},
+                         {sdwlk, street2}};
+    CityGrid grid(city);
+    PathCursor cursor(grid);
+    EXPECT(!cursor.hasNext());
+    EXPECT_ERROR(cursor.next());
+}
+
+STUDENT_TEST("PathCursor pulls paths from a million-street city one at a time"){
+    Grid<street> city = makeTestCity(1000, 1000, 5);
+    CityGrid grid(city);
+    PathCursor cursor(grid);
+    EXPECT(cursor.hasNext());
+
+    int previous = INT32_MAX;
+    for (int i = 0; i < 2000 && cursor.hasNext(); i++){
+        EXPECT_EQUAL(cursor.next().size(), 1999);
+        EXPECT(cursor.lastSafety() <= previous);
+        previous = cursor.lastSafety();
+    }
+    EXPECT_EQUAL(cursor.pathsPulled(), 2000);
+    TIME_OPERATION(1000000, PathCursor(grid).next());
+    TIME_OPERATION(2000, cursor.next());
+}
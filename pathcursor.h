@@ -0,0 +1,118 @@
+/*
+ * PathCursor hands out the right/down paths through a city one at a time,
+ * safest first, for as long as the caller keeps asking. Unlike
+ * safestRoutesTopK, nothing has to be decided up front about how many
+ * paths are wanted.
+ *
+ * Every path is the safest path (taken from a SafetyIndex) with a few
+ * "sidetracks": streets where it takes the other move instead. A sidetrack
+ * costs how much safer the best path from that street is than the best path
+ * through the other move. The sidetracks available from a street, along its
+ * safest path, are kept in a persistent heap that shares everything but
+ * one new spine with the heap of the next street on that path (Eppstein's
+ * k shortest paths). Pulling the next path pops one entry from a small
+ * frontier of candidates and pushes at most three more, so each call costs
+ * O(log paths pulled) plus the length of the path handed out. Sidetrack
+ * heaps are only built for streets a pulled path actually leaves from, and
+ * the frontier only grows with the number of paths pulled.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+#include "grid.h"
+#include "vector.h"
+#include "citygrid.h"
+#include "safetyindex.h"
+#include "solvestats.h"
+
+class PathCursor {
+public:
+    /** Prepares to enumerate the paths from (0, 0) to the bottom-right street. */
+    explicit PathCursor(const CityGrid& grid);
+
+    /** Whether there is another path to hand out. */
+    bool hasNext() const;
+
+    /**
+     * Returns the locations of the next path. Paths come out in order of
+     * descending safety rating and no path comes out twice. It is an error
+     * to call this once hasNext() is false.
+     *
+     * If stats isn't null, it is filled in with the work this call did:
+     * the sidetrack heap nodes it built, the candidates it pushed and
+     * popped, and the streets of the path it hands out.
+     */
+    Vector<GridLocation> next(SolveStats* stats = nullptr);
+
+    /** Safety rating of the path the last call to next() returned. */
+    int lastSafety() const {
+        return _lastSafety;
+    }
+
+    /** Number of paths handed out so far. */
+    int pathsPulled() const {
+        return _pathsPulled;
+    }
+
+private:
+    /* One sidetrack in a persistent leftist heap. Nodes never change once
+     * built, so heaps can share them.
+     */
+    struct HeapNode {
+        int loss;      // how much less safe taking the sidetrack is
+        int32_t cell;  // street where the path takes the other move
+        int32_t left;
+        int32_t right;
+        int rank;
+    };
+
+    /* A path that may be handed out: the sidetracks of the candidate it came
+     * from, plus the sidetrack in heap node `node`.
+     */
+    struct Candidate {
+        int32_t node;
+        int32_t parent; // candidate whose sidetracks come first, or -1
+    };
+
+    struct Entry {
+        long long loss;
+        int32_t candidate;
+    };
+    struct LaterEntry {
+        bool operator()(const Entry& lhs, const Entry& rhs) const {
+            if (lhs.loss != rhs.loss) return lhs.loss > rhs.loss;
+            return lhs.candidate > rhs.candidate;
+        }
+    };
+
+    size_t index(int row, int col) const {
+        return size_t(row) * _numCols + col;
+    }
+    bool isDestination(int32_t cell) const {
+        return cell == int32_t(index(_numRows - 1, _numCols - 1));
+    }
+    int32_t nextOnBest(int32_t cell) const;
+    int32_t sidetrackTarget(int32_t cell) const;
+    int32_t sidetrackHeap(int32_t cell);
+    int32_t insert(int32_t heap, int loss, int32_t cell);
+    int32_t merge(int32_t lhs, int32_t rhs);
+    void push(long long loss, int32_t node, int32_t parent);
+
+    const CityGrid& _grid;
+    SafetyIndex _index;
+    int _numRows;
+    int _numCols;
+    int _bestSafety;
+
+    std::vector<HeapNode> _nodes;
+    std::unordered_map<int32_t, int32_t> _heapOf; // street -> its sidetrack heap
+    std::vector<Candidate> _candidates;
+    std::priority_queue<Entry, std::vector<Entry>, LaterEntry> _frontier;
+    bool _handedOutBest = false;
+    int _lastSafety = 0;
+    int _pathsPulled = 0;
+};
@@ -0,0 +1,280 @@
+#include "router.h"
+#include "error.h"
+#include "testing/SimpleTest.h"
+#include "testdata.h"
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+using namespace std;
+
+namespace {
+    /* Orders heap entries so the lowest key, then lowest-numbered, cell is on
+     * top. Breaking ties on the cell keeps routes repeatable.
+     */
+    struct LaterEntry {
+        template <typename Entry>
+        bool operator()(const Entry& lhs, const Entry& rhs) const {
+            if (lhs.key != rhs.key) return lhs.key > rhs.key;
+            return lhs.cell > rhs.cell;
+        }
+    };
+
+    const int kRowSteps[] = {-1, 0, 1, 0};
+    const int kColSteps[] = {0, 1, 0, -1};
+}
+
+StreetRouter::StreetRouter(const CityGrid& grid)
+    : _grid(grid),
+      _cost(size_t(grid.numRows()) * grid.numCols()),
+      _cheapest(kStepCost),
+      _distance(_cost.size()),
+      _parent(_cost.size()),
+      _stamp(_cost.size(), 0) {
+    if (_cost.size() > size_t(INT32_MAX)) {
+        error("The city is too large to route over.");
+    }
+    int highest = INT_MIN;
+    for (int row = 0; row < grid.numRows(); row++) {
+        for (int col = 0; col < grid.numCols(); col++) {
+            highest = max(highest, grid.safety(row, col));
+        }
+    }
+    int cheapest = INT_MAX;
+    for (int row = 0; row < grid.numRows(); row++) {
+        for (int col = 0; col < grid.numCols(); col++) {
+            _cost[grid.index(row, col)] = highest - grid.safety(row, col) + kStepCost;
+            if (grid.isSidewalk(row, col)) {
+                cheapest = min(cheapest, _cost[grid.index(row, col)]);
+            }
+        }
+    }
+    if (cheapest != INT_MAX) {
+        _cheapest = cheapest;
+    }
+}
+
+long long StreetRouter::routeCost(const Vector<GridLocation>& route) const {
+    long long total = 0;
+    for (int i = 1; i < route.size(); i++) {
+        total += cost(route[i].row, route[i].col);
+    }
+    return total;
+}
+
+Vector<GridLocation> StreetRouter::route(GridLocation source, GridLocation destination,
+                                         RouteStats* stats, SolveStats* solveStats) {
+    return search(source, destination, false, stats, solveStats);
+}
+
+Vector<GridLocation> StreetRouter::routeAStar(GridLocation source, GridLocation destination,
+                                              RouteStats* stats, SolveStats* solveStats) {
+    return search(source, destination, true, stats, solveStats);
+}
+
+/*
+ * Label-setting search shared by route and routeAStar. With the heuristic
+ * off every estimate is zero and this is Dijkstra's algorithm. The
+ * heuristic is consistent (one step changes it by at most the cheapest
+ * cost), so a street's label is final the first time it is expanded.
+ */
+Vector<GridLocation> StreetRouter::search(GridLocation source, GridLocation destination,
+                                          bool useHeuristic, RouteStats* stats, SolveStats* solveStats) {
+    if (!_grid.inBounds(source.row, source.col) || !_grid.inBounds(destination.row, destination.col)) {
+        error("The source and destination must be in the city.");
+    }
+
+    /* Start a new query. If the stamp wraps around, old stamps could look
+     * current again, so clear them once.
+     */
+    if (++_query == 0) {
+        fill(_stamp.begin(), _stamp.end(), 0);
+        _query = 1;
+    }
+    _heap.clear();
+    size_t heapCapacity = _heap.capacity();
+
+    RouteStats work;
+    long long labelsPopped = 0;
+    size_t peakLabels = 1;
+    auto estimate = [&](int row, int col) -> long long {
+        if (!useHeuristic) return 0;
+        return (long long)(abs(row - destination.row) + abs(col - destination.col)) * _cheapest;
+    };
+
+    int cols = _grid.numCols();
+    int32_t start = int32_t(_grid.index(source.row, source.col));
+    int32_t goal = int32_t(_grid.index(destination.row, destination.col));
+    _stamp[start] = _query;
+    _distance[start] = 0;
+    _parent[start] = -1;
+    _heap.push_back({estimate(source.row, source.col), 0, start});
+    work.labelsPushed++;
+
+    bool found = false;
+    while (!_heap.empty()) {
+        pop_heap(_heap.begin(), _heap.end(), LaterEntry());
+        Entry top = _heap.back();
+        _heap.pop_back();
+        labelsPopped++;
+        if (top.distance != _distance[top.cell]) {
+            continue; // a cheaper label for this cell was already settled
+        }
+        if (top.cell == goal) {
+            found = true;
+            break;
+        }
+        work.nodesExpanded++;
+
+        int row = top.cell / cols;
+        int col = top.cell % cols;
+        for (int i = 0; i < 4; i++) {
+            int nextRow = row + kRowSteps[i];
+            int nextCol = col + kColSteps[i];
+            if (!_grid.inBounds(nextRow, nextCol) || !_grid.isSidewalk(nextRow, nextCol)) {
+                continue;
+            }
+            int32_t next = int32_t(_grid.index(nextRow, nextCol));
+            long long distance = top.distance + _cost[next];
+            if (_stamp[next] != _query || distance < _distance[next]) {
+                _stamp[next] = _query;
+                _distance[next] = distance;
+                _parent[next] = top.cell;
+                _heap.push_back({distance + estimate(nextRow, nextCol), distance, next});
+                push_heap(_heap.begin(), _heap.end(), LaterEntry());
+                work.labelsPushed++;
+                peakLabels = max(peakLabels, _heap.size());
+            }
+        }
+    }
+
+    if (stats != nullptr) {
+        *stats = work;
+    }
+    if (solveStats != nullptr) {
+        *solveStats = SolveStats();
+        solveStats->cellsVisited = work.nodesExpanded;
+        solveStats->pathsCreated = work.labelsPushed;
+        solveStats->queuePushes = work.labelsPushed;
+        solveStats->queuePops = labelsPopped;
+        solveStats->bytesAllocated = (_heap.capacity() - heapCapacity) * sizeof(Entry);
+        solveStats->peakFrontier = peakLabels;
+    }
+    if (!found) {
+        error("There is no safe walk between these streets.");
+    }
+
+    Vector<GridLocation> route;
+    for (int32_t cell = goal; cell != -1; cell = _parent[cell]) {
+        route.add(GridLocation(cell / cols, cell % cols));
+    }
+    reverse(route.begin(), route.end());
+    if (solveStats != nullptr) {
+        solveStats->bytesAllocated += route.size() * sizeof(GridLocation);
+    }
+    return route;
+}
+
+
+/* Cheapest cost from source to every street, by repeatedly relaxing every
+ * street until nothing changes. Slow, but simple enough to trust.
+ */
+static Grid<long long> relaxAll(const CityGrid& grid, const StreetRouter& router, GridLocation source) {
+    Grid<long long> best(grid.numRows(), grid.numCols(), LLONG_MAX);
+    best[source.row][source.col] = 0;
+    bool changed = true;
+    while (changed){
+        changed = false;
+        for (int row = 0; row < grid.numRows(); row++){
+            for (int col = 0; col < grid.numCols(); col++){
+                if (best[row][col] == LLONG_MAX){
+                    continue;
+                }
+                for (int i = 0; i < 4; i++){
+                    int nextRow = row + kRowSteps[i];
+                    int nextCol = col + kColSteps[i];
+                    if (grid.inBounds(nextRow, nextCol) && grid.isSidewalk(nextRow, nextCol)
+                            && best[row][col] + router.cost(nextRow, nextCol) < best[nextRow][nextCol]){
+                        best[nextRow][nextCol] = best[row][col] + router.cost(nextRow, nextCol);
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+    return best;
+}
+
+STUDENT_TEST("StreetRouter finds the cheapest four-direction walk"){
+    for (unsigned seed = 1; seed <= 5; seed++){
+        Grid<street> city = makeTestCity(8, 11, seed);
+        CityGrid grid(city);
+        StreetRouter router(grid);
+        GridLocation source(seed % 8, (seed * 3) % 11);
+        Grid<long long> best = relaxAll(grid, router, source);
+
+        for (int row = 0; row < city.numRows(); row++){
+            for (int col = 0; col < city.numCols(); col++){
+                GridLocation destination(row, col);
+                if (best[row][col] == LLONG_MAX){
+                    EXPECT_ERROR(router.route(source, destination));
+                    continue;
+                }
+                Vector<GridLocation> walk = router.route(source, destination);
+                EXPECT(walk[0] == source);
+                EXPECT(walk[walk.size() - 1] == destination);
+                EXPECT_EQUAL(router.routeCost(walk), best[row][col]);
+                EXPECT(walk == router.route(source, destination));
+            }
+        }
+    }
+}
+
+STUDENT_TEST("StreetRouter walks up and left around a wall"){
+    street sdwlk =  street(2, 3,  4, false);
+    street street2 =  street(0, 0, 0, true);
+
+    /* The only way from the top-right to the bottom-right is back along
+     * the top row, down the left side and along the bottom row.
+     */
+    Grid<street> city = {{street2, street2, street2, street2},
+                         {street2, sdwlk, sdwlk, sdwlk},
+                         {street2, street2, street2, street2}};
+    CityGrid grid(city);
+    StreetRouter router(grid);
+
+    Vector<GridLocation> walk = router.route(GridLocation(0, 3), GridLocation(2, 3));
+    EXPECT_EQUAL(walk.size(), 9);
+    EXPECT(walk[3] == GridLocation(0, 0));
+}
+
+STUDENT_TEST("A* finds walks as cheap as label-setting search with less work"){
+    for (unsigned seed = 1; seed <= 4; seed++){
+        Grid<street> city = makeTestCity(30, 40, seed);
+        CityGrid grid(city);
+        StreetRouter router(grid);
+        EXPECT_EQUAL(router.cheapestCost(), kStepCost);
+
+        for (int i = 0; i < 20; i++){
+            GridLocation source((i * 7) % 30, (i * 11) % 40);
+            GridLocation destination((i * 13 + 5) % 30, (i * 3 + 17) % 40);
+            RouteStats plain;
+            RouteStats aStar;
+            bool reachable = true;
+            long long expected = 0;
+            try {
+                expected = router.routeCost(router.route(source, destination, &plain));
+            } catch (...) {
+                reachable = false;
+            }
+            if (!reachable){
+                EXPECT_ERROR(router.routeAStar(source, destination));
+                continue;
+            }
+            Vector<GridLocation> walk = router.routeAStar(source, destination, &aStar);
+            EXPECT(walk[0] == source);
+            EXPECT(walk[walk.size() - 1] == destination);
+            EXPECT_EQUAL(router.routeCost(walk), expected);
+            EXPECT(aStar.nodesExpanded <= plain.nodesExpanded);
+        }
+    }
+}
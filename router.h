@@ -0,0 +1,110 @@
+/*
+ * StreetRouter finds the safest walk between any two streets of a city,
+ * moving up, down, left or right along sidewalks. Unlike the solvers in
+ * street.cpp, a walk may double back, so it is found with label-setting
+ * (Dijkstra) search over a non-negative cost per street instead of a
+ * right/down sweep.
+ *
+ * All search state lives in flat arrays sized to the city, allocated once
+ * when the router is built and reused by every query.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "grid.h"
+#include "vector.h"
+#include "citygrid.h"
+#include "solvestats.h"
+
+/* Cost added for every step, on top of how unsafe the street is. It keeps
+ * every street's cost positive, so a safe detour is never free.
+ */
+const int kStepCost = 1;
+
+/** How much work one route query did. */
+struct RouteStats {
+    int nodesExpanded = 0; // streets taken off the frontier and settled
+    int labelsPushed = 0;  // labels put on the frontier
+};
+
+class StreetRouter {
+public:
+    /**
+     * Prepares to route over the given city. The cost of stepping onto a
+     * street is (highest safety rating in the city - its safety rating)
+     * plus kStepCost, so the safest street costs kStepCost and no street
+     * costs less. The grid must outlive the router.
+     */
+    explicit StreetRouter(const CityGrid& grid);
+
+    int numRows() const {
+        return _grid.numRows();
+    }
+    int numCols() const {
+        return _grid.numCols();
+    }
+
+    /** Cost of stepping onto the street at (row, col). */
+    int cost(int row, int col) const {
+        return _cost[_grid.index(row, col)];
+    }
+
+    /** Lowest cost of any sidewalk, which is kStepCost unless there are none. */
+    int cheapestCost() const {
+        return _cheapest;
+    }
+
+    /** Sum of the costs of every street on the route after the first. */
+    long long routeCost(const Vector<GridLocation>& route) const;
+
+    /**
+     * Returns the locations of the cheapest walk from source to destination.
+     * The source street doesn't have to be a sidewalk; every other street
+     * does. Among equally cheap walks the same one is always returned. It is
+     * an error if the destination can't be reached.
+     *
+     * If stats isn't null, it is filled in with how much work the query did.
+     * If solveStats isn't null, the same work is filled in as SolveStats:
+     * streets expanded, labels pushed and popped, the most labels on the
+     * frontier at once, and memory the query added to the router's own.
+     * A router runs one query at a time.
+     */
+    Vector<GridLocation> route(GridLocation source, GridLocation destination,
+                               RouteStats* stats = nullptr, SolveStats* solveStats = nullptr);
+
+    /**
+     * Same as route, but searches with A*. Every step costs at least
+     * cheapestCost(), so the Manhattan distance to the destination times
+     * cheapestCost() never overestimates the remaining cost, and the walk
+     * found is just as cheap as the one route finds. Streets are settled in
+     * order of cost so far plus that estimate, so streets leading away from
+     * the destination are mostly never expanded.
+     */
+    Vector<GridLocation> routeAStar(GridLocation source, GridLocation destination,
+                                    RouteStats* stats = nullptr, SolveStats* solveStats = nullptr);
+
+private:
+    Vector<GridLocation> search(GridLocation source, GridLocation destination,
+                                bool useHeuristic, RouteStats* stats, SolveStats* solveStats);
+
+    const CityGrid& _grid;
+    std::vector<int32_t> _cost;
+    int _cheapest;
+
+    /* Per-query labels. A label is only valid when its stamp matches the
+     * current query, so nothing has to be cleared between queries.
+     */
+    std::vector<long long> _distance;
+    std::vector<int32_t> _parent;
+    std::vector<uint32_t> _stamp;
+    uint32_t _query = 0;
+
+    struct Entry {
+        long long key;      // distance, plus the estimate to go under A*
+        long long distance;
+        int32_t cell;
+    };
+    std::vector<Entry> _heap;
+};
@@ -0,0 +1,39 @@
+/*
+ * Solvers from street.cpp that find the safest right/down path from the
+ * top-left street of a city to the bottom-right one. Every solver returns
+ * the same Vector<street> shape: the streets of the path, in order,
+ * starting with the entry street. Each one also takes an optional
+ * SolveStats* to fill in with how much work the solve did; see
+ * solvestats.h.
+ */
+#pragma once
+
+#include <climits>
+#include "grid.h"
+#include "vector.h"
+#include "street.h"
+#include "citygrid.h"
+#include "pathcode.h"
+#include "solvestats.h"
+
+/* Score used for streets from which the exit cannot be reached. */
+const int kNoPath = INT_MIN;
+
+bool areEqual(Vector<street> path1, Vector<street> path2);
+int getPathSafetyVector(Vector<street> path);
+bool areEqual(const PathCode& path1, const PathCode& path2);
+int getPathSafetyVector(const PathCode& path, const CityGrid& grid);
+
+Vector<Vector<GridLocation>> safestRoutesTopK(const CityGrid& grid, int k, SolveStats* stats = nullptr);
+Vector<Vector<street>> safestPathsTopK(const Grid<street>& city, int k, SolveStats* stats = nullptr);
+
+Vector<street> safestPath1(const Grid<street>& city, SolveStats* stats = nullptr);
+Vector<street> safestPath2(const Grid<street>& city, SolveStats* stats = nullptr);
+Vector<street> safestPath3(const Grid<street>& cityStreet, SolveStats* stats = nullptr);
+
+Vector<GridLocation> safestRouteDP(const CityGrid& grid, SolveStats* stats = nullptr);
+Vector<street> safestPathDP(const Grid<street>& city, SolveStats* stats = nullptr);
+
+Vector<GridLocation> safestRouteLinear(const CityGrid& grid, long& peakBytes, SolveStats* stats = nullptr);
+Vector<street> safestPathLinear(const Grid<street>& city, long& peakBytes, SolveStats* stats = nullptr);
+Vector<street> safestPathLinear(const Grid<street>& city, SolveStats* stats = nullptr);
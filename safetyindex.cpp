@@ -0,0 +1,166 @@
+#include "safetyindex.h"
+#include "safestpath.h"
+#include "error.h"
+#include "testing/SimpleTest.h"
+#include "testdata.h"
+#include <algorithm>
+#include <chrono>
+using namespace std;
+
+SafetyIndex::SafetyIndex(const CityGrid& grid)
+    : SafetyIndex(grid, GridLocation(grid.numRows() - 1, grid.numCols() - 1)) {
+}
+
+SafetyIndex::SafetyIndex(const CityGrid& grid, GridLocation destination)
+    : _numRows(grid.numRows()),
+      _numCols(grid.numCols()),
+      _destination(destination) {
+    if (!grid.inBounds(destination.row, destination.col)) {
+        error("The destination is not in the city.");
+    }
+    auto start = chrono::steady_clock::now();
+    build(grid);
+    _buildSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+/*
+ * Scores streets from the destination back towards (0, 0). A street's own
+ * score assumes it is walkable, since a query may start on any street;
+ * whether a neighbor is a sidewalk is checked when the neighbor is stepped
+ * onto. Streets below or to the right of the destination keep kNoPath.
+ */
+void SafetyIndex::build(const CityGrid& grid) {
+    _best.assign(size_t(_numRows) * _numCols, kNoPath);
+    _goDown.assign((_best.size() + 63) / 64, 0);
+
+    int lastRow = _destination.row;
+    int lastCol = _destination.col;
+    for (int row = lastRow; row >= 0; row--) {
+        for (int col = lastCol; col >= 0; col--) {
+            size_t here = index(row, col);
+            if (row == lastRow && col == lastCol) {
+                _best[here] = grid.safety(row, col);
+                continue;
+            }
+            int right = (col < lastCol && grid.isSidewalk(row, col + 1)) ? _best[here + 1] : kNoPath;
+            int down = (row < lastRow && grid.isSidewalk(row + 1, col)) ? _best[here + _numCols] : kNoPath;
+            if (right == kNoPath && down == kNoPath) {
+                continue;
+            }
+            if (down > right) {
+                _goDown[here / 64] |= uint64_t(1) << (here % 64);
+            }
+            _best[here] = grid.safety(row, col) + max(right, down);
+        }
+    }
+}
+
+bool SafetyIndex::canReach(int row, int col) const {
+    if (row < 0 || col < 0 || row >= _numRows || col >= _numCols) {
+        error("The starting street is not in the city.");
+    }
+    return _best[index(row, col)] != kNoPath;
+}
+
+int SafetyIndex::bestSafety(int row, int col) const {
+    if (!canReach(row, col)) {
+        error("There is no safe path from this street to the destination.");
+    }
+    return _best[index(row, col)];
+}
+
+Vector<GridLocation> SafetyIndex::query(int startRow, int startCol, SolveStats* stats) const {
+    if (!canReach(startRow, startCol)) {
+        error("There is no safe path from this street to the destination.");
+    }
+    Vector<GridLocation> route;
+    int row = startRow;
+    int col = startCol;
+    route.add(GridLocation(row, col));
+    while (row != _destination.row || col != _destination.col) {
+        if (stepsDown(row, col)) {
+            row++;
+        } else {
+            col++;
+        }
+        route.add(GridLocation(row, col));
+    }
+    if (stats) {
+        *stats = SolveStats();
+        stats->cellsVisited = route.size();
+        stats->pathsCreated = 1;
+        stats->bytesAllocated = route.size() * sizeof(GridLocation);
+        stats->peakFrontier = 1;
+    }
+    return route;
+}
+
+size_t SafetyIndex::memoryBytes() const {
+    return _best.size() * sizeof(int32_t) + _goDown.size() * sizeof(uint64_t);
+}
+
+
+/* Copies the streets in rows fromRow..toRow and cols fromCol..toCol. */
+static Grid<street> subCity(const Grid<street>& city, int fromRow, int fromCol, int toRow, int toCol) {
+    Grid<street> sub(toRow - fromRow + 1, toCol - fromCol + 1);
+    for (int row = fromRow; row <= toRow; row++){
+        for (int col = fromCol; col <= toCol; col++){
+            sub[row - fromRow][col - fromCol] = city[row][col];
+        }
+    }
+    return sub;
+}
+
+/* Whether route equals expected once expected is moved by (rowShift, colShift). */
+static bool sameRoute(const Vector<GridLocation>& route, const Vector<GridLocation>& expected,
+                      int rowShift, int colShift) {
+    if (route.size() != expected.size()){
+        return false;
+    }
+    for (int i = 0; i < route.size(); i++){
+        if (route[i] != GridLocation(expected[i].row + rowShift, expected[i].col + colShift)){
+            return false;
+        }
+    }
+    return true;
+}
+
+STUDENT_TEST("SafetyIndex queries match solving from each start"){
+    for (unsigned seed = 1; seed <= 6; seed++){
+        Grid<street> city = makeTestCity(9, 12, seed);
+        SafetyIndex index(CityGrid(city), GridLocation(8, 11));
+        EXPECT(index.memoryBytes() >= size_t(9 * 12) * sizeof(int32_t));
+
+        for (int row = 0; row < city.numRows(); row++){
+            for (int col = 0; col < city.numCols(); col++){
+                CityGrid sub(subCity(city, row, col, 8, 11));
+                bool hasPath = true;
+                Vector<GridLocation> expected;
+                try {
+                    expected = safestRouteDP(sub);
+                } catch (...) {
+                    hasPath = false;
+                }
+                EXPECT_EQUAL(index.canReach(row, col), hasPath);
+                if (hasPath){
+                    EXPECT(sameRoute(index.query(row, col), expected, row, col));
+                }
+                else {
+                    EXPECT_ERROR(index.query(row, col));
+                }
+            }
+        }
+    }
+}
+
+STUDENT_TEST("SafetyIndex to a destination inside the city"){
+    Grid<street> city = makeTestCity(10, 10, 3);
+    city[6][4] = street(0, 0, 0, true);
+    SafetyIndex index(CityGrid(city), GridLocation(6, 4));
+    CityGrid sub(subCity(city, 0, 0, 6, 4));
+
+    EXPECT(sameRoute(index.query(0, 0), safestRouteDP(sub), 0, 0));
+    EXPECT(!index.canReach(7, 0));
+    EXPECT(!index.canReach(0, 5));
+    EXPECT_EQUAL(index.query(6, 4).size(), 1);
+}
@@ -0,0 +1,90 @@
+/*
+ * SafetyIndex answers safest path queries from any starting street to one
+ * fixed destination. It is built once per city and destination: for every
+ * street it stores the best safety rating of a right/down path from that
+ * street to the destination, plus one bit saying whether that path steps
+ * down or right first. A query just follows the stored bits, so it costs
+ * O(path length) and never rescans the city.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "grid.h"
+#include "vector.h"
+#include "citygrid.h"
+#include "solvestats.h"
+
+class SafetyIndex {
+public:
+    /** Builds an index of paths to the bottom-right street of the city. */
+    explicit SafetyIndex(const CityGrid& grid);
+
+    /** Builds an index of paths to the given destination. */
+    SafetyIndex(const CityGrid& grid, GridLocation destination);
+
+    int numRows() const {
+        return _numRows;
+    }
+    int numCols() const {
+        return _numCols;
+    }
+    GridLocation destination() const {
+        return _destination;
+    }
+
+    /**
+     * Returns whether there is a path from (row, col) to the destination.
+     * Like every solver, the starting street doesn't have to be a sidewalk
+     * but every other street on the path does.
+     */
+    bool canReach(int row, int col) const;
+
+    /**
+     * Returns the safety rating of the safest path from (row, col) to the
+     * destination. It is an error to ask for a street that can't reach it.
+     */
+    int bestSafety(int row, int col) const;
+
+    /**
+     * Returns whether the safest path from (row, col) steps down rather than
+     * right first. Only meaningful for streets that can reach the destination.
+     */
+    bool stepsDown(int row, int col) const {
+        size_t i = index(row, col);
+        return (_goDown[i / 64] >> (i % 64)) & 1;
+    }
+
+    /**
+     * Returns the locations of the safest path from (startRow, startCol)
+     * to the destination. Starting from (0, 0) gives exactly the path
+     * safestRouteDP returns; ties go right.
+     *
+     * If stats isn't null, it is filled in with the work of the query
+     * alone: the streets it follows and the path it hands back. The index
+     * itself is counted by memoryBytes().
+     */
+    Vector<GridLocation> query(int startRow, int startCol, SolveStats* stats = nullptr) const;
+
+    /** Bytes held by the score table and the step bits. */
+    size_t memoryBytes() const;
+
+    /** Wall-clock seconds the constructor took to build the index. */
+    double buildSeconds() const {
+        return _buildSeconds;
+    }
+
+private:
+    void build(const CityGrid& grid);
+    size_t index(int row, int col) const {
+        return size_t(row) * _numCols + col;
+    }
+
+    int _numRows;
+    int _numCols;
+    GridLocation _destination;
+    std::vector<int32_t> _best;
+    std::vector<uint64_t> _goDown;
+    double _buildSeconds = 0;
+};
@@ -0,0 +1,304 @@
+#include "snapshot.h"
+#include "packeddata.h"
+#include "huffmandecoder.h"
+#include "huffmanencoder.h"
+#include "safestpath.h"
+#include "error.h"
+#include "testing/SimpleTest.h"
+#include "testdata.h"
+#include <cstdint>
+#include <map>
+#include <sstream>
+#include <tuple>
+#include <vector>
+using namespace std;
+
+namespace {
+    /* "CS106B C SnApshot" */
+    const uint32_t kSnapshotHeader = 0xC5106C5A;
+    const uint8_t kEscape = 255;
+
+    struct PaletteEntry {
+        int32_t light;
+        int32_t crime;
+        int32_t density;
+        int32_t sidewalk;
+    };
+
+    /* Huffman-codes the bytes in the writeData format. */
+    PackedEncodedData huffmanEncode(const vector<uint8_t>& bytes) {
+        vector<long long> counts(256, 0);
+        for (uint8_t b : bytes) {
+            counts[b]++;
+        }
+        HuffmanEncoder encoder(counts);
+        PackedEncodedData data;
+        encoder.writeTree(data);
+        data.messageBits.reserve(encoder.encodedBits(counts));
+        encoder.encode(reinterpret_cast<const char*>(bytes.data()), bytes.size(), data.messageBits);
+        return data;
+    }
+
+    /*
+     * Hands out the decoded message one byte at a time, decoding it with
+     * lookup tables a chunk at a time.
+     */
+    class SnapshotDecoder {
+    public:
+        explicit SnapshotDecoder(const PackedEncodedData& data) : _data(data), _tables(data) {
+        }
+
+        uint8_t next() {
+            if (_next == _filled) {
+                refill();
+            }
+            return uint8_t(_chunk[_next++]);
+        }
+
+    private:
+        static const size_t kChunkSymbols = 4096;
+
+        void refill() {
+            _filled = _tables.decode(_data.messageBits, _bit, _chunk, kChunkSymbols);
+            if (_filled == 0) {
+                error("The snapshot ended before all its streets were read.");
+            }
+            _next = 0;
+        }
+
+        const PackedEncodedData& _data;
+        HuffmanTableDecoder _tables;
+        char _chunk[kChunkSymbols];
+        size_t _bit = 0;
+        size_t _next = 0;
+        size_t _filled = 0;
+    };
+
+    void writeInt(ostream& out, int32_t value) {
+        out.write(reinterpret_cast<const char*>(&value), sizeof value);
+    }
+
+    int32_t readInt(istream& in) {
+        int32_t value;
+        if (!in.read(reinterpret_cast<char*>(&value), sizeof value)) {
+            error("The snapshot ended in the middle of its header.");
+        }
+        return value;
+    }
+
+    /*
+     * Reads the header and palette, then calls onStreet(row, col, index)
+     * for every street in row-major order as its index is decoded.
+     */
+    template <typename OnStart, typename OnStreet>
+    void readSnapshotWith(istream& in, OnStart onStart, OnStreet onStreet) {
+        if (uint32_t(readInt(in)) != kSnapshotHeader) {
+            error("Chosen file is not a city snapshot.");
+        }
+        int numRows = readInt(in);
+        int numCols = readInt(in);
+        int paletteSize = readInt(in);
+        if (numRows < 1 || numCols < 1 || paletteSize < 1) {
+            error("The snapshot's header is damaged.");
+        }
+        vector<PaletteEntry> palette(paletteSize);
+        for (PaletteEntry& entry : palette) {
+            entry.light = readInt(in);
+            entry.crime = readInt(in);
+            entry.density = readInt(in);
+            entry.sidewalk = readInt(in);
+        }
+        onStart(numRows, numCols, palette);
+
+        PackedEncodedData data = readPackedData(in);
+        SnapshotDecoder decoder(data);
+        for (int row = 0; row < numRows; row++) {
+            for (int col = 0; col < numCols; col++) {
+                uint32_t index = decoder.next();
+                if (index == kEscape) {
+                    index = 0;
+                    for (int shift = 0; shift < 32; shift += 8) {
+                        index |= uint32_t(decoder.next()) << shift;
+                    }
+                }
+                if (index >= palette.size()) {
+                    error("The snapshot names a street that isn't in its palette.");
+                }
+                onStreet(row, col, index);
+            }
+        }
+    }
+}
+
+void writeSnapshot(const Grid<street>& city, ostream& out) {
+    map<tuple<int, int, int, bool>, uint32_t> interned;
+    vector<PaletteEntry> palette;
+    vector<uint8_t> indices;
+    indices.reserve(size_t(city.numRows()) * city.numCols());
+    for (int row = 0; row < city.numRows(); row++) {
+        for (int col = 0; col < city.numCols(); col++) {
+            const street& s = city[row][col];
+            auto key = make_tuple(s.getLight(), s.getCrime(), s.getDensity(), s.isSidewalk());
+            auto found = interned.find(key);
+            uint32_t index;
+            if (found != interned.end()) {
+                index = found->second;
+            } else {
+                index = uint32_t(palette.size());
+                interned[key] = index;
+                palette.push_back({s.getLight(), s.getCrime(), s.getDensity(), s.isSidewalk()});
+            }
+            if (index < kEscape) {
+                indices.push_back(uint8_t(index));
+            } else {
+                indices.push_back(kEscape);
+                for (int shift = 0; shift < 32; shift += 8) {
+                    indices.push_back(uint8_t(index >> shift));
+                }
+            }
+        }
+    }
+
+    writeInt(out, int32_t(kSnapshotHeader));
+    writeInt(out, city.numRows());
+    writeInt(out, city.numCols());
+    writeInt(out, int32_t(palette.size()));
+    for (const PaletteEntry& entry : palette) {
+        writeInt(out, entry.light);
+        writeInt(out, entry.crime);
+        writeInt(out, entry.density);
+        writeInt(out, entry.sidewalk);
+    }
+    writePackedData(huffmanEncode(indices), out);
+}
+
+CityGrid readSnapshotGrid(istream& in) {
+    int cols = 0;
+    int rows = 0;
+    vector<int32_t> paletteSafety;
+    vector<char> paletteSidewalk;
+    vector<int32_t> safety;
+    vector<uint64_t> sidewalk;
+    readSnapshotWith(in,
+        [&](int numRows, int numCols, const vector<PaletteEntry>& palette) {
+            rows = numRows;
+            cols = numCols;
+            for (const PaletteEntry& entry : palette) {
+                street s(entry.light, entry.crime, entry.density, entry.sidewalk != 0);
+                paletteSafety.push_back(s.getSafetyRating());
+                paletteSidewalk.push_back(s.isSidewalk());
+            }
+            size_t cells = size_t(numRows) * numCols;
+            safety.resize(cells);
+            sidewalk.assign((cells + 63) / 64, 0);
+        },
+        [&](int row, int col, uint32_t index) {
+            size_t i = size_t(row) * cols + col;
+            safety[i] = paletteSafety[index];
+            if (paletteSidewalk[index]) {
+                sidewalk[i / 64] |= uint64_t(1) << (i % 64);
+            }
+        });
+    return CityGrid(rows, cols, move(safety), move(sidewalk));
+}
+
+Grid<street> readSnapshot(istream& in) {
+    Grid<street> city;
+    vector<street> streets;
+    readSnapshotWith(in,
+        [&](int numRows, int numCols, const vector<PaletteEntry>& palette) {
+            city.resize(numRows, numCols);
+            for (const PaletteEntry& entry : palette) {
+                streets.push_back(street(entry.light, entry.crime, entry.density, entry.sidewalk != 0));
+            }
+        },
+        [&](int row, int col, uint32_t index) {
+            city[row][col] = streets[index];
+        });
+    return city;
+}
+
+
+/* A city where many streets share a few common kinds and the rest are
+ * spread over hundreds of others, so the palette needs escaped indices.
+ */
+static Grid<street> makeVariedCity(int rows, int cols, unsigned seed) {
+    Grid<street> city = makeTestCity(rows, cols, seed);
+    for (int row = 0; row < rows; row++){
+        for (int col = 0; col < cols; col++){
+            seed = seed * 1103515245 + 12345;
+            if ((seed >> 16) % 4 == 0){
+                int pick = (seed >> 8) % 1000;
+                city[row][col] = street(pick % 10, pick / 10 % 10, pick / 100, pick % 7 != 0);
+            }
+        }
+    }
+    return city;
+}
+
+static bool sameStreets(const Grid<street>& lhs, const Grid<street>& rhs) {
+    if (lhs.numRows() != rhs.numRows() || lhs.numCols() != rhs.numCols()){
+        return false;
+    }
+    for (int row = 0; row < lhs.numRows(); row++){
+        for (int col = 0; col < lhs.numCols(); col++){
+            if (!areEqual(Vector<street>{lhs[row][col]}, Vector<street>{rhs[row][col]})){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+STUDENT_TEST("Snapshots read back the streets they were written from"){
+    for (unsigned seed = 1; seed <= 3; seed++){
+        Grid<street> cities[] = {makeTestCity(13, 70, seed), makeVariedCity(40, 41, seed)};
+        for (const Grid<street>& city : cities){
+            stringstream snapshot;
+            writeSnapshot(city, snapshot);
+            string bytes = snapshot.str();
+
+            stringstream streetsIn(bytes);
+            EXPECT(sameStreets(readSnapshot(streetsIn), city));
+
+            stringstream gridIn(bytes);
+            CityGrid grid = readSnapshotGrid(gridIn);
+            CityGrid expected(city);
+            bool same = grid.numRows() == expected.numRows() && grid.numCols() == expected.numCols();
+            for (int row = 0; same && row < city.numRows(); row++){
+                for (int col = 0; col < city.numCols(); col++){
+                    same = same && grid.safety(row, col) == expected.safety(row, col)
+                           && grid.isSidewalk(row, col) == expected.isSidewalk(row, col);
+                }
+            }
+            EXPECT(same);
+        }
+    }
+
+    /* A city of one kind of street still needs a two-leaf tree. */
+    Grid<street> plain(3, 3, street(1, 2, 3, true));
+    stringstream snapshot;
+    writeSnapshot(plain, snapshot);
+    EXPECT(sameStreets(readSnapshot(snapshot), plain));
+
+    stringstream garbage("not a snapshot at all");
+    EXPECT_ERROR(readSnapshot(garbage));
+}
+
+STUDENT_TEST("Snapshots compress cities with few kinds of street"){
+    /* Raw size is the three attributes as int32s plus a sidewalk byte.
+     * The cities are deterministic, so so are the ratios: about 32 when
+     * every street is one of eight kinds and about 5 when a quarter of them
+     * are picked from a thousand. Ratios and throughput on million-street
+     * cities are reported by the benchmark programs.
+     */
+    Grid<street> cities[] = {makeTestCity(100, 100, 3), makeVariedCity(100, 100, 3)};
+    double minRatios[] = {25, 4};
+    for (int i = 0; i < 2; i++){
+        stringstream snapshot;
+        writeSnapshot(cities[i], snapshot);
+        double ratio = 100.0 * 100 * 13 / snapshot.str().size();
+        EXPECT(ratio > minRatios[i]);
+        EXPECT_EQUAL(readSnapshotGrid(snapshot).safety(99, 99), cities[i][99][99].getSafetyRating());
+    }
+}
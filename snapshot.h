@@ -0,0 +1,38 @@
+/*
+ * City snapshots are a compressed form of a city for shipping between
+ * hosts. Real cities repeat the same few kinds of street over and over, so
+ * a snapshot interns every distinct (light, crime, density, sidewalk)
+ * street into a small palette and Huffman-codes the sequence of palette
+ * indices, row by row, in the writeData format from bits.cpp.
+ *
+ * A snapshot is laid out as:
+ *
+ * 4 bytes:  magic number kSnapshotHeader
+ * 4 bytes:  number of rows
+ * 4 bytes:  number of columns
+ * 4 bytes:  number of palette entries, p
+ * 16p bytes: light, crime, density and sidewalk of each palette entry
+ * the rest: writeData's encoding of the palette indices
+ *
+ * Palette indices below 255 are one byte; any other index is the byte 255
+ * followed by the index's four bytes, lowest first.
+ *
+ * Decoding can go straight into a CityGrid: each palette entry's safety
+ * rating is computed once, and each street's rating and sidewalk flag are
+ * copied from its entry without ever building the street.
+ */
+#pragma once
+
+#include <iostream>
+#include "grid.h"
+#include "street.h"
+#include "citygrid.h"
+
+/** Writes a compressed snapshot of the city to the stream. */
+void writeSnapshot(const Grid<street>& city, std::ostream& out);
+
+/** Reads a snapshot back into the layout the solvers search. */
+CityGrid readSnapshotGrid(std::istream& in);
+
+/** Reads a snapshot back into the streets it was written from. */
+Grid<street> readSnapshot(std::istream& in);
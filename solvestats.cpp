@@ -0,0 +1,155 @@
+#include "solvestats.h"
+#include "safestpath.h"
+#include "citygen.h"
+#include "tiledpath.h"
+#include "wavefront.h"
+#include "safetyindex.h"
+#include "pathcursor.h"
+#include "incremental.h"
+#include "streaming.h"
+#include "router.h"
+#include "error.h"
+#include "testing/SimpleTest.h"
+#include "testdata.h"
+#include <sstream>
+using namespace std;
+
+ostream& operator <<(ostream& out, const SolveStats& stats) {
+    return out << "{\"cellsVisited\":" << stats.cellsVisited
+               << ",\"pathsCreated\":" << stats.pathsCreated
+               << ",\"queuePushes\":" << stats.queuePushes
+               << ",\"queuePops\":" << stats.queuePops
+               << ",\"bytesAllocated\":" << stats.bytesAllocated
+               << ",\"peakFrontier\":" << stats.peakFrontier << "}";
+}
+
+
+STUDENT_TEST("Stats print as one line of JSON"){
+    SolveStats stats;
+    stats.cellsVisited = 9;
+    stats.queuePops = 3;
+    stats.peakFrontier = 12345678901LL;
+    ostringstream out;
+    out << stats;
+    EXPECT_EQUAL(out.str(), "{\"cellsVisited\":9,\"pathsCreated\":0,\"queuePushes\":0,"
+                            "\"queuePops\":3,\"bytesAllocated\":0,\"peakFrontier\":12345678901}");
+}
+
+STUDENT_TEST("Counting work doesn't change the path"){
+    for (unsigned seed = 1; seed <= 10; seed++){
+        Grid<street> city = makeTestCity(5, 6, seed);
+        CityGrid grid(city);
+        bool hasPath = true;
+        try {
+            safestRouteDP(grid);
+        } catch (...) {
+            hasPath = false;
+        }
+        SolveStats stats;
+        if (!hasPath){
+            EXPECT_ERROR(safestPath3(city, &stats));
+            EXPECT(stats.queuePops > 0);
+            continue;
+        }
+        EXPECT(areEqual(safestPath1(city, &stats), safestPath1(city)));
+        EXPECT(areEqual(safestPath2(city, &stats), safestPath2(city)));
+        EXPECT(areEqual(safestPath3(city, &stats), safestPath3(city)));
+        EXPECT(areEqual(safestPathDP(city, &stats), safestPathDP(city)));
+        EXPECT(areEqual(safestPathLinear(city, &stats), safestPathLinear(city)));
+        EXPECT(safestRouteTiled(grid, 1, 4, &stats) == safestRouteDP(grid));
+        WavefrontCity diagonals(grid);
+        EXPECT(safestRouteWavefront(diagonals, WavefrontKernel::Auto, &stats) == safestRouteDP(grid));
+        SolveStats wavefront;
+        EXPECT(areEqual(safestPathWavefront(city, &wavefront), safestPathDP(city)));
+        EXPECT_EQUAL(wavefront.cellsVisited, stats.cellsVisited);
+    }
+}
+
+STUDENT_TEST("Stats count the work on a city of all sidewalks"){
+    CityProfile profile;
+    profile.sidewalkChance = 1;
+    profile.badBlockChance = 0;
+    Grid<street> city = CityGenerator(3, 4, 1, profile).city();
+    CityGrid grid(city);
+    SolveStats stats;
+
+    /* The table solvers score every street once and make no queues. */
+    safestRouteDP(grid, &stats);
+    EXPECT_EQUAL(stats.cellsVisited, 12);
+    EXPECT_EQUAL(stats.pathsCreated, 12);
+    EXPECT_EQUAL(stats.queuePushes, 0);
+    EXPECT(stats.bytesAllocated >= 12 * long(sizeof(int)));
+
+    long peakBytes = 0;
+    safestRouteLinear(grid, peakBytes, &stats);
+    EXPECT(stats.cellsVisited >= 12);
+    EXPECT_EQUAL(stats.peakFrontier, peakBytes / long(sizeof(int)));
+
+    safestRouteTiled(grid, 1, 2, &stats);
+    EXPECT_EQUAL(stats.cellsVisited, 12);
+    EXPECT(stats.bytesAllocated > 0);
+
+    /* With no gaps there are 10 right/down paths of 6 streets, and the
+     * recursion reaches the exit once along each of them.
+     */
+    safestPath2(city, &stats);
+    EXPECT(stats.cellsVisited >= 10);
+    EXPECT_EQUAL(stats.pathsCreated, stats.cellsVisited - 1);
+    EXPECT_EQUAL(stats.peakFrontier, 6);
+
+    /* Every path the iterative search makes is queued and taken off again. */
+    safestPath3(city, &stats);
+    EXPECT_EQUAL(stats.queuePushes, stats.queuePops);
+    EXPECT(stats.pathsCreated >= 10);
+    EXPECT(stats.bytesAllocated > 0);
+
+    /* A fresh solve starts its counts from zero. */
+    SolveStats again;
+    safestPath3(city, &again);
+    EXPECT_EQUAL(again.queuePushes, stats.queuePushes);
+}
+
+STUDENT_TEST("Query engines count the work of each query"){
+    CityProfile profile;
+    profile.sidewalkChance = 1;
+    profile.badBlockChance = 0;
+    Grid<street> city = CityGenerator(3, 4, 1, profile).city();
+    CityGrid grid(city);
+    SolveStats stats;
+
+    /* Following stored steps visits only the 6 streets of the path. */
+    SafetyIndex index(grid);
+    index.query(0, 0, &stats);
+    EXPECT_EQUAL(stats.cellsVisited, 6);
+    EXPECT_EQUAL(stats.bytesAllocated, 6 * long(sizeof(GridLocation)));
+    IncrementalSolver solver(city);
+    solver.route(&stats);
+    EXPECT_EQUAL(stats.cellsVisited, 6);
+    solver.updateStreet(2, 3, street(0, 0, 0, true), &stats);
+    EXPECT_EQUAL(stats.cellsVisited, solver.lastUpdateCells());
+
+    /* The first path pops nothing; every later one pops one candidate. */
+    PathCursor cursor(grid);
+    cursor.next(&stats);
+    EXPECT_EQUAL(stats.queuePops, 0);
+    EXPECT(stats.queuePushes > 0);
+    cursor.next(&stats);
+    EXPECT_EQUAL(stats.queuePops, 1);
+    EXPECT_EQUAL(stats.cellsVisited, 6);
+
+    /* Streaming scores every street of every row once. */
+    stringstream rows;
+    writeCityRows(city, rows);
+    EXPECT_EQUAL(streamSafestSafety(rows, &stats), getPathSafetyVector(safestPathDP(city)));
+    EXPECT_EQUAL(stats.cellsVisited, 12);
+    EXPECT_EQUAL(stats.peakFrontier, 4);
+
+    /* The router's stats match its own RouteStats. */
+    StreetRouter router(grid);
+    RouteStats work;
+    router.routeAStar(GridLocation(0, 0), GridLocation(2, 3), &work, &stats);
+    EXPECT_EQUAL(stats.cellsVisited, work.nodesExpanded);
+    EXPECT_EQUAL(stats.queuePushes, work.labelsPushed);
+    EXPECT(stats.queuePops > 0 && stats.queuePops <= stats.queuePushes);
+    EXPECT(stats.peakFrontier >= 1);
+}
@@ -0,0 +1,30 @@
+/*
+ * SolveStats records how much work one solve did, so a slow query can be
+ * matched up with the shape of the city that caused it.
+ *
+ * Every solver entry point takes an optional SolveStats* as its last
+ * argument. When it is null nothing is counted: the fast solvers work
+ * their counts out from the sizes of their tables after the solve, and
+ * the exhaustive searches count into locals that are copied out once at
+ * the end, so the pointer is only ever looked at once per solve.
+ *
+ * Counters that don't apply to a solver stay zero.
+ */
+#pragma once
+
+#include <iostream>
+
+struct SolveStats {
+    long long cellsVisited = 0;   // streets scored or expanded
+    long long pathsCreated = 0;   // partial paths, labels or scores made
+    long long queuePushes = 0;    // entries added to a queue or priority queue
+    long long queuePops = 0;      // entries taken off one
+    long long bytesAllocated = 0; // working memory allocated for tables, rows and paths
+    long long peakFrontier = 0;   // most paths or scores held at once waiting to be extended
+};
+
+/**
+ * Writes the stats as one JSON object on one line, for logging next to a
+ * query's latency.
+ */
+std::ostream& operator <<(std::ostream& out, const SolveStats& stats);
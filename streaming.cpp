@@ -0,0 +1,278 @@
+#include "streaming.h"
+#include "safestpath.h"
+#include "citygrid.h"
+#include "error.h"
+#include "testing/SimpleTest.h"
+#include "testdata.h"
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+using namespace std;
+
+namespace {
+    void readSize(istream& in, int& numRows, int& numCols) {
+        if (!(in >> numRows >> numCols) || numRows < 1 || numCols < 1) {
+            error("The city stream doesn't start with its number of rows and columns.");
+        }
+    }
+
+    void readRow(istream& in, Vector<street>& row) {
+        for (int col = 0; col < row.size(); col++) {
+            int light, crime, density, sidewalk;
+            if (!(in >> light >> crime >> density >> sidewalk)) {
+                error("The city stream ended in the middle of a row.");
+            }
+            row[col] = street(light, crime, density, sidewalk != 0);
+        }
+    }
+}
+
+StreamingSolver::StreamingSolver(int numCols)
+    : _numCols(numCols),
+      _best(numCols, kNoPath),
+      _fromAbove((numCols + 63) / 64, 0) {
+    if (numCols < 1) {
+        error("A city needs at least one column.");
+    }
+}
+
+StreamingSolver::StreamingSolver(int numCols, const string& spillFile)
+    : StreamingSolver(numCols) {
+    _spill.open(spillFile, ios::in | ios::out | ios::binary | ios::trunc);
+    if (!_spill) {
+        error("Could not open the spill file.");
+    }
+    _spilling = true;
+}
+
+/*
+ * Works across the row from left to right, the same recurrence as
+ * linearForwardRow: a street's score is its safety plus the better of the
+ * street above (still in _best) and the street to its left (just written).
+ */
+void StreamingSolver::addRow(const Vector<street>& row) {
+    if (row.size() != _numCols) {
+        error("Every row of the city must have the same number of streets.");
+    }
+    fill(_fromAbove.begin(), _fromAbove.end(), 0);
+    int left = kNoPath;
+    for (int col = 0; col < _numCols; col++) {
+        const street& s = row[col];
+        int up = (_rowsSeen > 0) ? _best[col] : kNoPath;
+        int score;
+        if (_rowsSeen == 0 && col == 0) {
+            score = s.getSafetyRating();
+        } else if (!s.isSidewalk() || (up == kNoPath && left == kNoPath)) {
+            score = kNoPath;
+        } else {
+            if (up > left) {
+                _fromAbove[col / 64] |= uint64_t(1) << (col % 64);
+            }
+            score = s.getSafetyRating() + max(up, left);
+        }
+        _best[col] = score;
+        left = score;
+    }
+
+    if (_spilling) {
+        size_t rowBytes = _fromAbove.size() * sizeof(uint64_t);
+        _spill.seekp(streamoff(_rowsSeen) * rowBytes);
+        if (!_spill.write(reinterpret_cast<const char*>(_fromAbove.data()), rowBytes)) {
+            error("Could not write to the spill file.");
+        }
+    }
+    _rowsSeen++;
+}
+
+bool StreamingSolver::hasPath() const {
+    return _rowsSeen > 0 && _best[_numCols - 1] != kNoPath;
+}
+
+/*
+ * Every street of every row is scored once into the one row of scores,
+ * so the counts follow from the number of rows seen.
+ */
+void StreamingSolver::countRows(SolveStats& stats) const {
+    stats = SolveStats();
+    stats.cellsVisited = (long long)_rowsSeen * _numCols;
+    stats.pathsCreated = stats.cellsVisited;
+    stats.bytesAllocated = workingBytes();
+    stats.peakFrontier = _numCols;
+}
+
+int StreamingSolver::bestSafety(SolveStats* stats) const {
+    if (stats) {
+        countRows(*stats);
+    }
+    if (!hasPath()) {
+        error("There is no safe path through the city.");
+    }
+    return _best[_numCols - 1];
+}
+
+Vector<GridLocation> StreamingSolver::route(SolveStats* stats) {
+    if (!_spilling) {
+        error("The path can only be rebuilt when decision bits are spilled.");
+    }
+    if (stats) {
+        countRows(*stats);
+    }
+    if (!hasPath()) {
+        error("There is no safe path through the city.");
+    }
+    _spill.flush();
+    size_t rowBytes = _fromAbove.size() * sizeof(uint64_t);
+    vector<uint64_t> bits(_fromAbove.size());
+    auto loadRow = [&](int row) {
+        _spill.seekg(streamoff(row) * rowBytes);
+        if (!_spill.read(reinterpret_cast<char*>(bits.data()), rowBytes)) {
+            error("Could not read back the spill file.");
+        }
+    };
+
+    Vector<GridLocation> route;
+    int row = _rowsSeen - 1;
+    int col = _numCols - 1;
+    loadRow(row);
+    route.add(GridLocation(row, col));
+    while (row > 0 || col > 0) {
+        if ((bits[col / 64] >> (col % 64)) & 1) {
+            row--;
+            loadRow(row);
+        } else {
+            col--;
+        }
+        route.add(GridLocation(row, col));
+    }
+    reverse(route.begin(), route.end());
+    if (stats) {
+        stats->cellsVisited += route.size();
+        stats->bytesAllocated += rowBytes + route.size() * sizeof(GridLocation);
+    }
+    return route;
+}
+
+size_t StreamingSolver::workingBytes() const {
+    return _best.size() * sizeof(int32_t) + _fromAbove.size() * sizeof(uint64_t);
+}
+
+void writeCityRows(const Grid<street>& city, ostream& out) {
+    out << city.numRows() << " " << city.numCols() << "\n";
+    for (int row = 0; row < city.numRows(); row++) {
+        for (int col = 0; col < city.numCols(); col++) {
+            const street& s = city[row][col];
+            out << s.getLight() << " " << s.getCrime() << " " << s.getDensity()
+                << " " << (s.isSidewalk() ? 1 : 0) << (col + 1 < city.numCols() ? " " : "\n");
+        }
+    }
+}
+
+int streamSafestSafety(istream& in, SolveStats* stats) {
+    int numRows, numCols;
+    readSize(in, numRows, numCols);
+    StreamingSolver solver(numCols);
+    Vector<street> row(numCols);
+    for (int r = 0; r < numRows; r++) {
+        readRow(in, row);
+        solver.addRow(row);
+    }
+    return solver.bestSafety(stats);
+}
+
+Vector<GridLocation> streamSafestRoute(istream& in, const string& spillFile, SolveStats* stats) {
+    int numRows, numCols;
+    readSize(in, numRows, numCols);
+    StreamingSolver solver(numCols, spillFile);
+    Vector<street> row(numCols);
+    for (int r = 0; r < numRows; r++) {
+        readRow(in, row);
+        solver.addRow(row);
+    }
+    return solver.route(stats);
+}
+
+
+/* Whether route is a right/down path from the entry to the exit of city
+ * with every street after the first a sidewalk.
+ */
+static bool isWalkableRoute(const Grid<street>& city, const Vector<GridLocation>& route) {
+    if (route.size() != city.numRows() + city.numCols() - 1 || !(route[0] == GridLocation(0, 0))){
+        return false;
+    }
+    for (int i = 1; i < route.size(); i++){
+        int rowStep = route[i].row - route[i - 1].row;
+        int colStep = route[i].col - route[i - 1].col;
+        if (rowStep + colStep != 1 || rowStep < 0 || colStep < 0
+                || !city[route[i].row][route[i].col].isSidewalk()){
+            return false;
+        }
+    }
+    return true;
+}
+
+STUDENT_TEST("Streaming a city row by row finds the safest path"){
+    const string spillFile = "streaming-test.spill";
+    for (unsigned seed = 1; seed <= 8; seed++){
+        Grid<street> city = makeTestCity(10 + seed, 70 - seed, seed);
+        CityGrid grid(city);
+        stringstream text;
+        writeCityRows(city, text);
+
+        bool hasPath = true;
+        int expected = 0;
+        try {
+            expected = getPathSafetyVector(streetsAlong(city, safestRouteDP(grid)));
+        } catch (...) {
+            hasPath = false;
+        }
+        if (!hasPath){
+            EXPECT_ERROR(streamSafestSafety(text));
+            continue;
+        }
+        EXPECT_EQUAL(streamSafestSafety(text), expected);
+
+        stringstream again(text.str());
+        Vector<GridLocation> route = streamSafestRoute(again, spillFile);
+        EXPECT(isWalkableRoute(city, route));
+        EXPECT_EQUAL(getPathSafetyVector(streetsAlong(city, route)), expected);
+    }
+    remove(spillFile.c_str());
+}
+
+STUDENT_TEST("StreamingSolver keeps one row no matter how many rows go by"){
+    street sdwlk =  street(2, 3,  4, false);
+    street street1 =  street(10, 1, 1, true);
+    Vector<street> open(40, street1);
+    Vector<street> walled(40, sdwlk);
+
+    StreamingSolver solver(40);
+    size_t bytes = solver.workingBytes();
+    for (int row = 0; row < 5000; row++){
+        solver.addRow(open);
+        EXPECT_EQUAL(solver.workingBytes(), bytes);
+    }
+    EXPECT_EQUAL(solver.bestSafety(), (5000 + 39) * street1.getSafetyRating());
+    EXPECT_ERROR(solver.route());
+    EXPECT_ERROR(solver.addRow(Vector<street>(39, street1)));
+
+    solver.addRow(walled);
+    EXPECT(!solver.hasPath());
+    EXPECT_ERROR(solver.bestSafety());
+
+    stringstream garbled("2 3\n1 1 1 1 1 1");
+    EXPECT_ERROR(streamSafestSafety(garbled));
+}
+
+STUDENT_TEST("Streaming a million-street city"){
+    const string spillFile = "streaming-test.spill";
+    Grid<street> city = makeTestCity(1000, 1000, 5);
+    stringstream text;
+    writeCityRows(city, text);
+    string rows = text.str();
+
+    stringstream scoreOnly(rows);
+    stringstream withRoute(rows);
+    TIME_OPERATION(1000000, streamSafestSafety(scoreOnly));
+    TIME_OPERATION(1000000, streamSafestRoute(withRoute, spillFile));
+    remove(spillFile.c_str());
+}
@@ -0,0 +1,99 @@
+/*
+ * StreamingSolver finds the safest right/down path through a city that
+ * arrives one row at a time, for cities too large to hold in memory. A
+ * street's best score from the entry only depends on the street above it
+ * and the street to its left, so only the current row of scores is kept:
+ * working memory is O(columns) no matter how many rows go by.
+ *
+ * Optionally the solver writes a spill file holding one bit per street
+ * saying whether the best path to it came from above or from the left,
+ * packed 64 to a word, one row after another. Once every row is in, the
+ * path is rebuilt by walking those bits backwards from the exit, reading
+ * one row of bits at a time.
+ *
+ * Cities stream as text: the number of rows and columns, then every street
+ * as "light crime density sidewalk" (sidewalk is 0 or 1), row by row.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "grid.h"
+#include "vector.h"
+#include "street.h"
+#include "solvestats.h"
+
+class StreamingSolver {
+public:
+    /** Solves for the safest score only, keeping nothing but one row. */
+    explicit StreamingSolver(int numCols);
+
+    /**
+     * Also writes decision bits to the given spill file so route() can
+     * rebuild the path. The file is created, or emptied if it exists.
+     */
+    StreamingSolver(int numCols, const std::string& spillFile);
+
+    int numCols() const {
+        return _numCols;
+    }
+    int rowsSeen() const {
+        return _rowsSeen;
+    }
+
+    /** Scores the next row of the city. It must have numCols() streets. */
+    void addRow(const Vector<street>& row);
+
+    /** Whether the last street of the last row added can be reached. */
+    bool hasPath() const;
+
+    /**
+     * Safety rating of the safest path to the last street of the last row.
+     * If stats isn't null, it is filled in with the work of every row
+     * added so far.
+     */
+    int bestSafety(SolveStats* stats = nullptr) const;
+
+    /**
+     * Rebuilds the safest path to the last street of the last row from the
+     * spill file. Among equally safe paths it keeps the one that arrives at
+     * each street from the left, so on ties it can differ from
+     * safestRouteDP, which prefers to leave each street to the right.
+     * If stats isn't null, it is filled in with the work of every row
+     * added so far plus rebuilding the path.
+     */
+    Vector<GridLocation> route(SolveStats* stats = nullptr);
+
+    /** Bytes of scores, decision bits and spill buffer held in memory. */
+    size_t workingBytes() const;
+
+private:
+    void countRows(SolveStats& stats) const;
+
+    int _numCols;
+    int _rowsSeen = 0;
+    std::vector<int32_t> _best;
+    std::vector<uint64_t> _fromAbove;
+    bool _spilling = false;
+    std::fstream _spill;
+};
+
+/** Writes the city in the text form StreamingSolver reads. */
+void writeCityRows(const Grid<street>& city, std::ostream& out);
+
+/**
+ * Reads a city from the stream one row at a time and returns the safety
+ * rating of its safest path. Only one row is ever held in memory.
+ */
+int streamSafestSafety(std::istream& in, SolveStats* stats = nullptr);
+
+/**
+ * Reads a city from the stream, spilling decision bits to spillFile, and
+ * returns the locations of its safest path.
+ */
+Vector<GridLocation> streamSafestRoute(std::istream& in, const std::string& spillFile,
+                                       SolveStats* stats = nullptr);
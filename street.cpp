@@ -5,6 +5,9 @@
  */
 
 #include <string>
+#include <climits>
+#include <algorithm>
+#include <vector>
 #include "grid.h"
 #include "testing/SimpleTest.h"
 #include "error.h"
@@ -13,10 +16,16 @@
 #include "strlib.h"
 #include "priorityqueue.h"
 #include "street.h"
+#include "citygrid.h"
+#include "citygen.h"
+#include "safestpath.h"
+#include "patharena.h"
+#include "trace.h"
 
 #include "set.h"
 #include "queue.h"
 #include "stack.h"
+#include "testdata.h"
 
 using namespace std;
 
@@ -60,88 +69,224 @@ int getPathSafetyVector(Vector<street> path){
     return output;
 }
 
+/**
+ * @brief areEqual. This function takes two packed paths and
+ * determines if they are equal by comparing their starting streets
+ * and their moves, 64 moves at a time.
+ * @param path1 is the first path to be compared
+ * @param path2 is the second path to be compared
+ * @return true if path1 and path2 are equal and
+ * false if path1 and path2 are not equal.
+ */
+bool areEqual(const PathCode& path1, const PathCode& path2){
+    return path1 == path2;
+}
+
+/**
+ * @brief getPathSafetyVector returns the safety rating
+ * of the entire packed path by reading its moves in place,
+ * without expanding it to streets or locations
+ * @param path is a PathCode for which the safety rating is needed
+ * @param grid is the CityGrid the path goes through
+ * @return an int of the safety rating of the entire path
+ */
+int getPathSafetyVector(const PathCode& path, const CityGrid& grid){
+    int output = 0;
+    path.forEachLocationBackward([&](GridLocation loc){
+        output += grid.safety(loc.row, loc.col);
+    });
+    return output;
+}
+
 /**
   Solution 1
-  Let N be the number of rows in the grid and let M be the number of columns.
-  Since this function will call itself at most twice, it will have a runtime of O((NM)^2).
+  Let N be the number of rows in the grid, M be the number of columns and K be
+  the number of paths wanted. Each street keeps its K best paths to the exit,
+  merged from the K best of the street to its right and the K best of the street
+  below it, so the runtime is O(NMK) and the tables take O(NMK) space.
   */
+
+/* One of the K best paths from a street to the exit: its safety rating,
+ * whether it steps right or down first, and which of that neighbor's
+ * best paths it continues with.
+ */
+struct RankedStep {
+    int safety;
+    bool goRight;
+    int nextRank;
+};
+
 /**
- * @brief safestPath1Helper is a helper function that uses recursion to
- * find all of the valid paths in the city and inserts them in a
- * priority queue based on their safety rating
- * @param city is a Grid of streets that is analyzed to find the safest path
- * @param row is an int in the current row position of the street
- * at which the recursive function is at.
- * @param col is an int in the current col position of the street
- * at which the recursive function is at.
- * @param path is the current path the recursive function is taking
- * through the city
- * @param solutions is a PriorityQueue<Vector<street>> that is passed
- * by reference is holds all of the valid paths as well as their safety
- * rating as the path's priority value
+ * @brief safestRoutesTopK returns the locations of the K safest distinct
+ * paths through the city, safest first. Paths with the same safety rating
+ * are ordered by their moves, with a right move before a down move at the
+ * first place they differ, so the order is always the same and the first
+ * path is the one safestRouteDP returns.
+ * @param grid is a CityGrid for which the safest paths are wanted
+ * @param k is an int of how many paths are wanted, at least one
+ * @param stats is a SolveStats* that, if not null, is filled in with
+ * how much work the solve did
+ * @return a Vector<Vector<GridLocation>> of up to k paths; it only has
+ * fewer than k if the city has fewer than k paths
  */
-void safestPath1Helper(Grid<street> city, int row, int col, Vector<street> path, PriorityQueue<Vector<street>>& solutions){
-    if (row == city.numRows() - 1 && col == city.numCols() - 1){
-        solutions.enqueue(path, -(getPathSafetyVector(path)));
-        //negative because safer paths will have a lower priority value
+Vector<Vector<GridLocation>> safestRoutesTopK(const CityGrid& grid, int k, SolveStats* stats){
+    if (k < 1){
+        error("At least one path must be asked for.");
     }
-    else {
-        Vector<street> rightPath = path;
-        Vector<street> downPath = path;
-        if (row < city.numRows() - 1 && city[row + 1][col].isSidewalk()){
-            downPath.add(city[row + 1][col]);
-            safestPath1Helper(city, row + 1, col, downPath, solutions);
+    int rows = grid.numRows();
+    int cols = grid.numCols();
+    vector<RankedStep> ranked(size_t(rows) * cols * k);
+    vector<int> count(size_t(rows) * cols, 0);
+
+    TraceSpan searching("safestRoutesTopK search");
+    for (int row = rows - 1; row >= 0; row--){
+        for (int col = cols - 1; col >= 0; col--){
+            if (!grid.isWalkable(row, col)){
+                continue;
+            }
+            size_t here = grid.index(row, col);
+            RankedStep* best = ranked.data() + here * k;
+            if (row == rows - 1 && col == cols - 1){
+                best[0] = {grid.safety(row, col), true, 0};
+                count[here] = 1;
+                continue;
+            }
+
+            /* Merge the two neighbors' lists, which are already in order. */
+            const RankedStep* right = (col < cols - 1) ? ranked.data() + (here + 1) * k : nullptr;
+            const RankedStep* down = (row < rows - 1) ? ranked.data() + (here + cols) * k : nullptr;
+            int rightCount = right ? count[here + 1] : 0;
+            int downCount = down ? count[here + cols] : 0;
+            int r = 0;
+            int d = 0;
+            int n = 0;
+            while (n < k && (r < rightCount || d < downCount)){
+                bool takeRight = (d == downCount)
+                        || (r < rightCount && right[r].safety >= down[d].safety);
+                if (takeRight){
+                    best[n] = {grid.safety(row, col) + right[r].safety, true, r};
+                    r++;
+                }
+                else {
+                    best[n] = {grid.safety(row, col) + down[d].safety, false, d};
+                    d++;
+                }
+                n++;
+            }
+            count[here] = n;
         }
-        if (col < city.numCols() - 1 && city[row][col + 1].isSidewalk()){
-            rightPath.add(city[row][col + 1]);
-            safestPath1Helper(city, row, col + 1, rightPath, solutions);
+    }
+    searching.end();
+
+    if (stats){
+        *stats = SolveStats();
+        stats->cellsVisited = (long long)rows * cols;
+        for (int n : count){
+            stats->pathsCreated += n;
+        }
+        stats->bytesAllocated = ranked.size() * sizeof(RankedStep) + count.size() * sizeof(int);
+        stats->peakFrontier = stats->pathsCreated;
+    }
+
+    if (count[0] == 0){
+        error("There is no safe path through the city.");
+    }
+
+    TraceSpan rebuilding("safestRoutesTopK path reconstruction");
+    Vector<Vector<GridLocation>> routes;
+    for (int i = 0; i < count[0]; i++){
+        Vector<GridLocation> route;
+        int row = 0;
+        int col = 0;
+        int rank = i;
+        route.add(GridLocation(row, col));
+        while (row != rows - 1 || col != cols - 1){
+            const RankedStep& step = ranked[grid.index(row, col) * k + rank];
+            if (step.goRight){
+                col++;
+            }
+            else {
+                row++;
+            }
+            rank = step.nextRank;
+            route.add(GridLocation(row, col));
         }
+        routes.add(route);
+    }
+    return routes;
+}
+
+/**
+ * @brief safestPathsTopK returns the streets of the K safest distinct
+ * paths through the city, safest first. See safestRoutesTopK.
+ * @param city is a Grid<street> for which the safest paths are wanted
+ * @param k is an int of how many paths are wanted, at least one
+ * @param stats is a SolveStats* that, if not null, is filled in with
+ * how much work the solve did
+ * @return a Vector<Vector<street>> of up to k paths
+ */
+Vector<Vector<street>> safestPathsTopK(const Grid<street>& city, int k, SolveStats* stats){
+    TraceSpan solving("safestPathsTopK");
+    TraceSpan converting("grid conversion");
+    CityGrid grid(city);
+    converting.end();
+    Vector<Vector<GridLocation>> routes = safestRoutesTopK(grid, k, stats);
+    TraceSpan convertingBack("vector conversion");
+    Vector<Vector<street>> paths;
+    for (const Vector<GridLocation>& route : routes){
+        paths.add(streetsAlong(city, route));
     }
+    return paths;
 }
 
 /**
  * @brief safestPath1 returns the Vector<street> of the
- * safest path through the city using a recursive helper
- * function and a priority queue. It finds all possible solutions
- * in the recursive portion and then returns the safest
- * option using the priority queue.
+ * safest path through the city by ranking paths with
+ * safestPathsTopK and taking the first one.
  * @param city is a Grid<street> for which the safest
  * path is wanted to be found
+ * @param stats is a SolveStats* that, if not null, is filled in with
+ * how much work the solve did
  * @return the Vector<street> of the
  * safest path through the city
  */
-Vector<street> safestPath1(Grid<street> city){
-    PriorityQueue<Vector<street>> solutions;
-    Vector<street> path;
-    path.add(city[0][0]);
-    safestPath1Helper(city, 0, 0, path, solutions);
-    return solutions.dequeue();
+Vector<street> safestPath1(const Grid<street>& city, SolveStats* stats){
+    TraceSpan solving("safestPath1");
+    return safestPathsTopK(city, 1, stats)[0];
 }
 
 
 
 //Solution 2
+/* A packed path together with its safety rating, so that choosing the
+ * safer of two paths never has to walk either of them.
+ */
+struct ScoredPath {
+    PathCode path;
+    int safety = 0;
+};
+
 /**
  * @brief getSaferPath is a helper function
  * that takes two paths and returns the
  * safer path. It checks that both paths
  * are the same size.
- * @param path1 is a Vector<street> of the
+ * @param path1 is a ScoredPath of the
  * first path to be considered.
- * @param path2 is a Vector<street> of the
- * first path to be considered.
- * @return a Vector<street> of the path that is
+ * @param path2 is a ScoredPath of the
+ * second path to be considered.
+ * @return a ScoredPath of the path that is
  * safer or longer.
  */
-Vector<street> getSaferPath(Vector<street> path1, Vector<street> path2){
-    if (path1.size() > path2.size()){
+ScoredPath getSaferPath(const ScoredPath& path1, const ScoredPath& path2){
+    if (path1.path.numMoves() > path2.path.numMoves()){
         return path1;
     }
-    else if (path2.size() > path1.size()){
+    else if (path2.path.numMoves() > path1.path.numMoves()){
         return path2;
     }
     else {
-        if (getPathSafetyVector(path1) >= getPathSafetyVector(path2)){
+        if (path1.safety >= path2.safety){
             return path1;
         }
         return path2;
@@ -151,192 +296,534 @@ Vector<street> getSaferPath(Vector<street> path1, Vector<street> path2){
 /**
  * @brief safestPath2Helper is a helper function
  * that uses recursive backtracking to find the safest path in the city
- * and only returns the safest path
- * @param city is a Grid of streets that is analyzed to find the path
+ * and only returns the safest path. Paths are PathCodes, so extending
+ * the path for each branch copies a few words instead of every street,
+ * and each path carries its safety rating so far, so extending it
+ * costs O(1).
+ * @param grid is the CityGrid that is analyzed to find the path
  * @param row is an int in the current row position of the street
  * at which the recursive function is at.
  * @param col is an int in the current col position of the street
  * at which the recursive function is at.
  * @param path is the current path the recursive function is taking
- * through the city
- * @return a Vector<street> of the single safest path in the city
+ * through the city, with its safety rating
+ * @param counts is a SolveStats passed by reference that counts the
+ * streets visited and paths made
+ * @return a ScoredPath of the single safest path in the city, or an
+ * empty path if the exit can't be reached from here
  */
-Vector<street> safestPath2Helper(Grid<street> city, int row, int col, Vector<street>& path){
-    if (row == city.numRows() - 1 && col == city.numCols() - 1){ // end of path
+ScoredPath safestPath2Helper(const CityGrid& grid, int row, int col, const ScoredPath& path, SolveStats& counts){
+    counts.cellsVisited++;
+    counts.peakFrontier = max(counts.peakFrontier, (long long)path.path.numMoves() + 1);
+    if (row == grid.numRows() - 1 && col == grid.numCols() - 1){ // end of path
         return path;
     }
-    else if (row == city.numRows() - 1){ //last row
-        if (!city[row][col + 1].isSidewalk()){
-            return {};
-        }
-        path.add(city[row][col + 1]);
-        return safestPath2Helper(city, row, col + 1, path);
-    }
-    else if (col == city.numCols() - 1){
-        if (!city[row + 1][col].isSidewalk()){
-            return {};
-        }
-        path.add(city[row + 1][col]);
-        return safestPath2Helper(city, row + 1, col, path);
+    ScoredPath rightPath;
+    ScoredPath downPath;
+    if (col < grid.numCols() - 1 && grid.isSidewalk(row, col + 1)){
+        rightPath = path;
+        rightPath.path.addRight();
+        rightPath.safety += grid.safety(row, col + 1);
+        counts.pathsCreated++;
+        rightPath = safestPath2Helper(grid, row, col + 1, rightPath, counts);
     }
-    else {
-        Vector<street> rightPath = path;
-        Vector<street> downPath = path;
-        if (city[row + 1][col].isSidewalk()){
-            downPath.add(city[row + 1][col]);
-        }
-        if (city[row][col + 1].isSidewalk()){
-            rightPath.add(city[row][col + 1]);
-        }
-        rightPath = safestPath2Helper(city, row, col + 1, rightPath);
-        downPath = safestPath2Helper(city, row + 1, col, downPath);
-        return getSaferPath(rightPath, downPath);
+    if (row < grid.numRows() - 1 && grid.isSidewalk(row + 1, col)){
+        downPath = path;
+        downPath.path.addDown();
+        downPath.safety += grid.safety(row + 1, col);
+        counts.pathsCreated++;
+        downPath = safestPath2Helper(grid, row + 1, col, downPath, counts);
     }
-    return {};
+    return getSaferPath(rightPath, downPath);
 }
 
 /**
  * @brief safestPath2 returns the Vector<street> of the
  * safest path through the city using a recursive helper
- * function.
+ * function. The path is only expanded to streets at the end.
  * @param city is a Grid<street> for which the safest
  * path is wanted to be found
+ * @param stats is a SolveStats* that, if not null, is filled in with
+ * how much work the solve did
  * @return the Vector<street> of the
  * safest path through the city
  */
 
-Vector<street> safestPath2(Grid<street> city){
-    Vector<street> path = {};
-    path.add(city[0][0]);
-    return safestPath2Helper(city, 0, 0, path);
+Vector<street> safestPath2(const Grid<street>& city, SolveStats* stats){
+    TraceSpan solving("safestPath2");
+    TraceSpan converting("grid conversion");
+    CityGrid grid(city);
+    converting.end();
+    SolveStats counts;
+    TraceSpan searching("safestPath2 search");
+    PathCode path = safestPath2Helper(grid, 0, 0, {PathCode(), grid.safety(0, 0)}, counts).path;
+    searching.end();
+    if (stats){
+        counts.bytesAllocated = counts.pathsCreated * (long long)sizeof(ScoredPath);
+        *stats = counts;
+    }
+    if (path.numMoves() != grid.numRows() + grid.numCols() - 2){
+        error("There is no safe path through the city.");
+    }
+    TraceSpan convertingBack("vector conversion");
+    return path.streets(city);
 }
 
 
 //Solution 3
 
 /**
- * @brief generateValidMoves is function that takes in
- * the city as both a grid of GridLocation and streets
- * and the current Gridlocation the generates the valid
- * moves from the current location. It considers
- * whether or not the next moves are sidewalks and
- * are in bounds
- * @param city a Grid<GridLocation> passed by reference
- * that is the city for which the next moves can be found in
- * @param cur is a GridLocation of the current location
- * of the function
- * @param cityStreet is Grid<street> passed by reference
- * that is the city for which the next moves can be found in
- * @return is a Set<GridLocation> of the next valid moves from
- * the current location, cur.
+ * @brief branchesRight checks which of two paths of the same length
+ * turns right first. It walks both back to the street where they split
+ * and looks at the step each took from there.
+ * @param arena is the PathArena holding both paths
+ * @param first is the node the first path ends at
+ * @param second is the node the second path ends at, a different street
+ * @return true if the first path took the right step where they split
  */
-Set<GridLocation> generateValidMoves(Grid<GridLocation>& city, GridLocation cur, Grid<street>& cityStreet) {
-    int cur_x = cur.row;
-    int cur_y = cur.col;
-    Vector<GridLocation> possible_locations = {GridLocation(cur_x, cur_y + 1),
-                                               GridLocation(cur_x +  1, cur_y)};
-    Set<GridLocation> neighbors;
-    for (GridLocation location : possible_locations) {
-        if (city.inBounds(location) &&
-                cityStreet[location.row][location.col].isSidewalk()) {
-            neighbors.add(location);
-        }
+static bool branchesRight(const PathArena& arena, int32_t first, int32_t second) {
+    while (arena[first].parent != arena[second].parent) {
+        first = arena[first].parent;
+        second = arena[second].parent;
     }
-    return neighbors;
+    return arena[first].col > arena[second].col;
 }
 
 /**
- * @brief getGridLocPathSafety takes in a path that is a
- * Stack<GridLocation> and returns its safety rating by finding
- * the GridLocation's equivalent street and respective
- * safety rating.
- * @param path is a Stack<GridLocation> for which the safety
- * rating is to be found.
- * @param city is a Grid<street> for which the path's safety rating
- * needs to be found through
- * @return an int that is the path's safety rating.
+ * @brief offerPath is a helper function that hands the search a path
+ * that extends the node from by one street. The first path to reach a
+ * street becomes its node. A later path to the same street takes that node
+ * over if it is safer, or as safe and turns right first.
+ * @param arena is the PathArena that holds the search's nodes
+ * @param bestAt is a vector<int32_t> of the node for each street, or kNoParent
+ * @param city is the CityGrid being searched
+ * @param from is the node being extended
+ * @param row is the row of the street being stepped onto
+ * @param col is the column of the street being stepped onto
+ * @param counts is a SolveStats passed by reference that counts the paths made
  */
-int getGridLocPathSafety(Stack<GridLocation> path, Grid<street>& city){
-    int output = 0;
-    while (!path.isEmpty()){
-        GridLocation loc = path.pop();
-        output += city[loc.row][loc.col].getSafetyRating();
-
+static void offerPath(PathArena& arena, vector<int32_t>& bestAt, const CityGrid& city,
+                      int32_t from, int row, int col, SolveStats& counts) {
+    int32_t safety = arena[from].safety + city.safety(row, col);
+    int32_t& node = bestAt[city.index(row, col)];
+    counts.pathsCreated++;
+    if (node == kNoParent) {
+        node = arena.add(from, row, col, safety);
+        counts.queuePushes++;
+    } else if (safety > arena[node].safety
+               || (safety == arena[node].safety && branchesRight(arena, from, arena[node].parent))) {
+        arena.reparent(node, from, safety);
     }
-    return output;
 }
 
 /**
  * @brief safestPath3Helper is a helper function
  * that iteratively finds the safest path through the city
- * using Gridlocations, Stacks, PriorityQueues, Queues, and Sets.
- * The function takes in a grid of the same city as both a grid of
- * GridLocations and streets. The GridLocation corresponds to the street
- * at the position in the grid. The function finds all possible paths
- * and returns the safest path using a priority queue, where the priority
- * is determined based on the path's safety rating.
- * @param city is a Grid<GridLocation> that is analyzed to find the safest path
- * @param cityStreet is a Grid<street> that is analyzed to find the safest path
- * @return a Stack<GridLocation> of the safest path in the city
+ * with a breadth-first search over paths. Each path is a node in
+ * the arena that holds its last street, the path it extends, and
+ * its safety rating so far, so extending a path is O(1) and no path
+ * is ever copied or rescored. The arena adds nodes in order, so it is
+ * also the search's queue. Every path to a street has the same length,
+ * so all of them are offered before the street's node is taken off the
+ * queue, and only the safest needs to be kept. A tie goes to the path that
+ * turns right first, which is the path safestPathDP picks.
+ * @param city is a CityGrid that is analyzed to find the safest path
+ * @param arena is a PathArena passed by reference that is reset and
+ * then holds one node for each street the search reaches
+ * @param counts is a SolveStats passed by reference that counts the
+ * paths made and the queue traffic
+ * @return a Vector<GridLocation> of the safest path in the city
  */
-Stack<GridLocation> safestPath3Helper(Grid<GridLocation>& city, Grid<street>& cityStreet) {
-    Stack<GridLocation> path;
-    PriorityQueue<Stack<GridLocation>> solutions;
-    Queue<Stack<GridLocation>> paths;
-    GridLocation entry = GridLocation(0,0);
-    GridLocation exit = {city.numRows()-1,  city.numCols()-1};
-    path.push(entry);
-    paths.enqueue(path);
-    Set<GridLocation> checked_moves;
-    while (paths.size() > 0){
-        Stack<GridLocation> curr_path = paths.dequeue();
-        checked_moves.add(curr_path.peek());
-        if (curr_path.peek() == exit) {
-            solutions.enqueue(curr_path, -(getGridLocPathSafety(curr_path, cityStreet)));
-            //negative because safer paths will have a lower priority value
+Vector<GridLocation> safestPath3Helper(const CityGrid& city, PathArena& arena, SolveStats& counts) {
+    int rows = city.numRows();
+    int cols = city.numCols();
+    vector<int32_t> bestAt(size_t(rows) * cols, kNoParent);
+    size_t arenaBytes = arena.capacityBytes();
+    arena.reset();
+    bestAt[0] = arena.add(kNoParent, 0, 0, city.safety(0, 0));
+    counts.pathsCreated++;
+    counts.queuePushes++;
+    int32_t next = 0;
+    while (next < arena.size()){
+        int32_t here = next++;
+        PathNode node = arena[here];
+        counts.queuePops++;
+        counts.peakFrontier = max(counts.peakFrontier, (long long)(arena.size() - here));
+        if (node.col + 1 < cols && city.isSidewalk(node.row, node.col + 1)) {
+            offerPath(arena, bestAt, city, here, node.row, node.col + 1, counts);
         }
-        else{
-            Set<GridLocation> valid_moves = generateValidMoves(city, curr_path.peek(), cityStreet);
-            for (GridLocation move : valid_moves) {
-                if (!checked_moves.contains(move)) {
-                    Stack<GridLocation> new_path = curr_path;
-                    new_path.push(move);
-                    paths.enqueue(new_path);
-                }
-            }
+        if (node.row + 1 < rows && city.isSidewalk(node.row + 1, node.col)) {
+            offerPath(arena, bestAt, city, here, node.row + 1, node.col, counts);
         }
-
     }
 
-    return solutions.dequeue();
-
+    counts.cellsVisited = arena.size();
+    counts.bytesAllocated = (arena.capacityBytes() - arenaBytes) + bestAt.size() * sizeof(int32_t);
+    int32_t exit = bestAt[city.index(rows - 1, cols - 1)];
+    if (exit == kNoParent){
+        error("There is no safe path through the city.");
+    }
+    Vector<GridLocation> route = arena.route(exit);
+    counts.bytesAllocated += route.size() * sizeof(GridLocation);
+    return route;
 }
+
 /**
  * @brief safestPath3 is an iterative function that
  * uses a helper function to find the safest path through
- * the city. The function creates a new Grid<GridLocation>, in
- * which each GridLocation corresponds to a street. It uses a
- * helper function to find the safest path as a Stack<GridLocation>
- * and converts it to a Vector<street>.
+ * the city. The function builds a CityGrid of the streets, finds
+ * the safest path as a Vector<GridLocation> with the helper, and
+ * looks up its streets.
  * @param cityStreet is a Grid<street> that is
  * analyzed to find the safest path
+ * @param stats is a SolveStats* that, if not null, is filled in with
+ * how much work the solve did
  * @return the Vector<street> of the
  * safest path through the city
  *
  *  Let N be the number of rows in the grid and let M be the number of columns.
- *  Then the runtime of this function is O((NM)(N + M - 1)^2), since it goes through each row and column during the iteration.
- *  Then, the function does vector insertion, which is 0(k^2) where k is the size of the vector
- *  because the vector moves all of the elements for each insert. The vector size is (N + M - 1).
+ *  Each street gets at most one node and is offered at most two paths, so the
+ *  search is O(NM) in time and memory, plus O(N + M) to break each tie.
+ *  Only the safest path is spelled out, in O(N + M). The arena is kept for the
+ *  thread, so once it has grown to fit a query it doesn't allocate again.
  */
-Vector<street> safestPath3(Grid<street>& cityStreet){
-    Grid<GridLocation> city(cityStreet.numRows(), cityStreet.numCols());
-    Stack<GridLocation> stackOutput = safestPath3Helper(city, cityStreet);
-    Vector<street> output;
-    while (!stackOutput.isEmpty()){
-        GridLocation loc = stackOutput.pop();
-        output.insert(0, cityStreet[loc.row][loc.col]);
-    } //reverse vector function
-    return output;
+Vector<street> safestPath3(const Grid<street>& cityStreet, SolveStats* stats){
+    TraceSpan solving("safestPath3");
+    TraceSpan converting("grid conversion");
+    CityGrid city(cityStreet);
+    converting.end();
+    thread_local PathArena arena;
+    SolveStats counts;
+    Vector<GridLocation> route;
+    TraceSpan searching("safestPath3 search");
+    try {
+        route = safestPath3Helper(city, arena, counts);
+    } catch (...) {
+        if (stats) *stats = counts;
+        throw;
+    }
+    searching.end();
+    if (stats) *stats = counts;
+    TraceSpan convertingBack("vector conversion");
+    return streetsAlong(cityStreet, route);
+}
+
+
+//Solution 4
+
+/**
+ * @brief safestRouteDP returns the locations of the safest path through
+ * the city using dynamic programming. Working backwards from the exit,
+ * it fills a table with the best safety rating from every street to the
+ * exit and remembers whether that best path first moves right or down.
+ * The path is then rebuilt by following those choices from the entry.
+ * Ties go to the right move, which is the same choice safestPath2 makes.
+ * @param grid is a CityGrid for which the safest path is wanted to be found
+ * @param stats is a SolveStats* that, if not null, is filled in with
+ * how much work the solve did
+ * @return a Vector<GridLocation> of the safest path through the city
+ *
+ *  Let N be the number of rows in the grid and let M be the number of columns.
+ *  Each street is scored once from its two neighbors, so the runtime is O(NM)
+ *  and the tables take O(NM) space. Rebuilding the path is O(N + M).
+ */
+Vector<GridLocation> safestRouteDP(const CityGrid& grid, SolveStats* stats){
+    int rows = grid.numRows();
+    int cols = grid.numCols();
+    vector<int> best(size_t(rows) * cols, kNoPath);
+    vector<char> goRight(size_t(rows) * cols, false);
+
+    TraceSpan searching("safestRouteDP search");
+    for (int row = rows - 1; row >= 0; row--){
+        for (int col = cols - 1; col >= 0; col--){
+            if (!grid.isWalkable(row, col)){
+                continue;
+            }
+            size_t here = grid.index(row, col);
+            if (row == rows - 1 && col == cols - 1){
+                best[here] = grid.safety(row, col);
+                continue;
+            }
+            int right = (col < cols - 1) ? best[here + 1] : kNoPath;
+            int down = (row < rows - 1) ? best[here + cols] : kNoPath;
+            if (right == kNoPath && down == kNoPath){
+                continue;
+            }
+            goRight[here] = (right >= down);
+            best[here] = grid.safety(row, col) + max(right, down);
+        }
+    }
+    searching.end();
+
+    if (stats){
+        *stats = SolveStats();
+        stats->cellsVisited = (long long)rows * cols;
+        stats->pathsCreated = best.size() - count(best.begin(), best.end(), kNoPath);
+        stats->bytesAllocated = best.size() * sizeof(int) + goRight.size();
+        stats->peakFrontier = stats->pathsCreated;
+    }
+
+    if (best[0] == kNoPath){
+        error("There is no safe path through the city.");
+    }
+
+    TraceSpan rebuilding("safestRouteDP path reconstruction");
+    Vector<GridLocation> route;
+    int row = 0;
+    int col = 0;
+    route.add(GridLocation(row, col));
+    while (row != rows - 1 || col != cols - 1){
+        if (goRight[grid.index(row, col)]){
+            col++;
+        }
+        else {
+            row++;
+        }
+        route.add(GridLocation(row, col));
+    }
+    return route;
+}
+
+/**
+ * @brief safestPathDP returns the Vector<street> of the
+ * safest path through the city using dynamic programming.
+ * See safestRouteDP.
+ * @param city is a Grid<street> for which the safest
+ * path is wanted to be found
+ * @param stats is a SolveStats* that, if not null, is filled in with
+ * how much work the solve did
+ * @return the Vector<street> of the
+ * safest path through the city
+ */
+Vector<street> safestPathDP(const Grid<street>& city, SolveStats* stats){
+    TraceSpan solving("safestPathDP");
+    TraceSpan converting("grid conversion");
+    CityGrid grid(city);
+    converting.end();
+    Vector<GridLocation> route = safestRouteDP(grid, stats);
+    TraceSpan convertingBack("vector conversion");
+    return streetsAlong(city, route);
+}
+
+
+//Solution 5
+
+/**
+ * @brief linearForwardRow fills prefix with the best safety rating of any
+ * path that starts on (fromRow, fromCol) and ends on each street of
+ * toRow, between columns fromCol and toCol. Only one row of scores is
+ * kept, and it is updated in place as the rows are swept.
+ * @param grid is a CityGrid that contains the streets
+ * @param fromRow is an int of the row the paths start on
+ * @param fromCol is an int of the col the paths start on
+ * @param toRow is an int of the row whose scores are wanted
+ * @param toCol is an int of the last col the paths may use
+ * @param prefix is a Vector<int> passed by reference that is filled
+ * with one score per column, or kNoPath if the street can't be reached
+ */
+void linearForwardRow(const CityGrid& grid, int fromRow, int fromCol, int toRow, int toCol, Vector<int>& prefix){
+    int width = toCol - fromCol + 1;
+    prefix = Vector<int>(width, kNoPath);
+    for (int row = fromRow; row <= toRow; row++){
+        for (int i = 0; i < width; i++){
+            int col = fromCol + i;
+            if (row == fromRow && i == 0){
+                prefix[i] = grid.safety(row, col);
+                continue;
+            }
+            int up = (row > fromRow) ? prefix[i] : kNoPath;
+            int left = (i > 0) ? prefix[i - 1] : kNoPath;
+            if (!grid.isWalkable(row, col) || (up == kNoPath && left == kNoPath)){
+                prefix[i] = kNoPath;
+            }
+            else {
+                prefix[i] = grid.safety(row, col) + max(up, left);
+            }
+        }
+    }
+}
+
+/**
+ * @brief linearBackwardRow fills suffix with the best safety rating of any
+ * path that starts on each street of fromRow, between columns fromCol
+ * and toCol, and ends on (toRow, toCol). It is the mirror image of
+ * linearForwardRow.
+ * @param grid is a CityGrid that contains the streets
+ * @param fromRow is an int of the row whose scores are wanted
+ * @param fromCol is an int of the first col the paths may use
+ * @param toRow is an int of the row the paths end on
+ * @param toCol is an int of the col the paths end on
+ * @param suffix is a Vector<int> passed by reference that is filled
+ * with one score per column, or kNoPath if the exit can't be reached
+ */
+void linearBackwardRow(const CityGrid& grid, int fromRow, int fromCol, int toRow, int toCol, Vector<int>& suffix){
+    int width = toCol - fromCol + 1;
+    suffix = Vector<int>(width, kNoPath);
+    for (int row = toRow; row >= fromRow; row--){
+        for (int i = width - 1; i >= 0; i--){
+            int col = fromCol + i;
+            if (!grid.isWalkable(row, col)){
+                suffix[i] = kNoPath;
+                continue;
+            }
+            if (row == toRow && i == width - 1){
+                suffix[i] = grid.safety(row, col);
+                continue;
+            }
+            int down = (row < toRow) ? suffix[i] : kNoPath;
+            int right = (i < width - 1) ? suffix[i + 1] : kNoPath;
+            if (down == kNoPath && right == kNoPath){
+                suffix[i] = kNoPath;
+            }
+            else {
+                suffix[i] = grid.safety(row, col) + max(down, right);
+            }
+        }
+    }
+}
+
+/**
+ * @brief safestRouteLinearHelper is a helper function that uses divide and
+ * conquer to add the safest path from (fromRow, fromCol) to (toRow, toCol)
+ * onto the end of route. It scores the top half of the rows forwards and
+ * the bottom half backwards, picks the column where the safest path steps
+ * down between the two halves, and then solves each half on its own.
+ * When two columns tie it picks the rightmost one, which matches the
+ * right-first choice made by safestRouteDP.
+ * @param grid is a CityGrid that is analyzed to find the safest path
+ * @param fromRow is an int of the row of the first street of the path
+ * @param fromCol is an int of the col of the first street of the path
+ * @param toRow is an int of the row of the last street of the path
+ * @param toCol is an int of the col of the last street of the path
+ * @param route is a Vector<GridLocation> passed by reference that the
+ * locations of the path are added onto
+ * @param liveBytes is a long passed by reference that holds the number of
+ * bytes of score rows that are currently allocated
+ * @param peakBytes is a long passed by reference that holds the most
+ * bytes of score rows that were ever allocated at once
+ * @param counts is a SolveStats passed by reference that counts the
+ * streets scored and the score rows allocated
+ */
+void safestRouteLinearHelper(const CityGrid& grid, int fromRow, int fromCol, int toRow, int toCol,
+                             Vector<GridLocation>& route, long& liveBytes, long& peakBytes,
+                             SolveStats& counts){
+    if (fromRow == toRow){
+        for (int col = fromCol; col <= toCol; col++){
+            if (!grid.isWalkable(fromRow, col)){
+                error("There is no safe path through the city.");
+            }
+            route.add(GridLocation(fromRow, col));
+        }
+        return;
+    }
+
+    int midRow = (fromRow + toRow) / 2;
+    int bestCol = -1;
+    int bestScore = kNoPath;
+    {
+        Vector<int> prefix;
+        Vector<int> suffix;
+        linearForwardRow(grid, fromRow, fromCol, midRow, toCol, prefix);
+        linearBackwardRow(grid, midRow + 1, fromCol, toRow, toCol, suffix);
+
+        long rowBytes = 2 * (toCol - fromCol + 1) * long(sizeof(int));
+        liveBytes += rowBytes;
+        peakBytes = max(peakBytes, liveBytes);
+        counts.cellsVisited += (long long)(toRow - fromRow + 1) * (toCol - fromCol + 1);
+        counts.bytesAllocated += rowBytes;
+
+        for (int i = 0; i < prefix.size(); i++){
+            if (prefix[i] != kNoPath && suffix[i] != kNoPath
+                    && prefix[i] + suffix[i] >= bestScore){
+                bestScore = prefix[i] + suffix[i];
+                bestCol = fromCol + i;
+            }
+        }
+        liveBytes -= rowBytes;
+    }
+
+    if (bestCol == -1){
+        error("There is no safe path through the city.");
+    }
+    safestRouteLinearHelper(grid, fromRow, fromCol, midRow, bestCol, route, liveBytes, peakBytes, counts);
+    safestRouteLinearHelper(grid, midRow + 1, bestCol, toRow, toCol, route, liveBytes, peakBytes, counts);
+}
+
+/**
+ * @brief safestRouteLinear returns the locations of the safest path
+ * through the city while only keeping two rows of scores in memory at
+ * a time, using Hirschberg-style middle-row splitting. It returns the
+ * same path as safestRouteDP.
+ * @param grid is a CityGrid for which the safest path is wanted to be found
+ * @param peakBytes is a long passed by reference that is set to the
+ * largest number of bytes of score rows held at once during the solve
+ * @param stats is a SolveStats* that, if not null, is filled in with
+ * how much work the solve did
+ * @return a Vector<GridLocation> of the safest path through the city
+ *
+ *  Let N be the number of rows in the grid and let M be the number of columns.
+ *  Each level of splitting scores at most NM streets in total and the number of
+ *  streets scored halves on every level, so the runtime is O(NM), about twice that
+ *  of safestRouteDP. The score rows take O(M) space and the recursion is O(log N) deep.
+ */
+Vector<GridLocation> safestRouteLinear(const CityGrid& grid, long& peakBytes, SolveStats* stats){
+    Vector<GridLocation> route;
+    long liveBytes = 0;
+    peakBytes = 0;
+    SolveStats counts;
+    TraceSpan searching("safestRouteLinear search");
+    try {
+        safestRouteLinearHelper(grid, 0, 0, grid.numRows() - 1, grid.numCols() - 1, route,
+                                liveBytes, peakBytes, counts);
+    } catch (...) {
+        if (stats) *stats = counts;
+        throw;
+    }
+    if (stats){
+        counts.pathsCreated = counts.cellsVisited;
+        counts.peakFrontier = peakBytes / long(sizeof(int));
+        *stats = counts;
+    }
+    return route;
+}
+
+/**
+ * @brief safestPathLinear returns the Vector<street> of the
+ * safest path through the city using linear memory.
+ * See safestRouteLinear.
+ * @param city is a Grid<street> for which the safest
+ * path is wanted to be found
+ * @param peakBytes is a long passed by reference that is set to the
+ * largest number of bytes of score rows held at once during the solve
+ * @param stats is a SolveStats* that, if not null, is filled in with
+ * how much work the solve did
+ * @return the Vector<street> of the
+ * safest path through the city
+ */
+Vector<street> safestPathLinear(const Grid<street>& city, long& peakBytes, SolveStats* stats){
+    TraceSpan solving("safestPathLinear");
+    TraceSpan converting("grid conversion");
+    CityGrid grid(city);
+    converting.end();
+    Vector<GridLocation> route = safestRouteLinear(grid, peakBytes, stats);
+    TraceSpan convertingBack("vector conversion");
+    return streetsAlong(city, route);
+}
+
+/**
+ * @brief safestPathLinear returns the Vector<street> of the
+ * safest path through the city using linear memory, without
+ * reporting how much memory was used.
+ * @param city is a Grid<street> for which the safest
+ * path is wanted to be found
+ * @param stats is a SolveStats* that, if not null, is filled in with
+ * how much work the solve did
+ * @return the Vector<street> of the
+ * safest path through the city
+ */
+Vector<street> safestPathLinear(const Grid<street>& city, SolveStats* stats){
+    long peakBytes = 0;
+    return safestPathLinear(city, peakBytes, stats);
 }
 
 //TESTING
@@ -353,16 +840,21 @@ STUDENT_TEST("Very simple example"){
     Vector<street> actual1 = safestPath1(city);
     Vector<street> actual2 = safestPath2(city);
     Vector<street> actual3 = safestPath2(city);
+    Vector<street> actualDP = safestPathDP(city);
+    Vector<street> actualLinear = safestPathLinear(city);
 
 
     EXPECT(areEqual(expectedPath, actual1));
     EXPECT(areEqual(expectedPath, actual2));
     EXPECT(areEqual(expectedPath, actual3));
+    EXPECT(areEqual(expectedPath, actualDP));
+    EXPECT(areEqual(expectedPath, actualLinear));
 
     //n is total number of elements in the grid
     TIME_OPERATION(4, safestPath1(city));
     TIME_OPERATION(4, safestPath2(city));
     TIME_OPERATION(4, safestPath3(city));
+    TIME_OPERATION(4, safestPathDP(city));
 }
 
 STUDENT_TEST("Simple example"){
@@ -378,15 +870,20 @@ STUDENT_TEST("Simple example"){
     Vector<street> actual1 = safestPath1(city);
     Vector<street> actual2 = safestPath2(city);
     Vector<street> actual3 = safestPath2(city);
+    Vector<street> actualDP = safestPathDP(city);
+    Vector<street> actualLinear = safestPathLinear(city);
 
 
     EXPECT(areEqual(expectedPath, actual1));
     EXPECT(areEqual(expectedPath, actual2));
     EXPECT(areEqual(expectedPath, actual3));
+    EXPECT(areEqual(expectedPath, actualDP));
+    EXPECT(areEqual(expectedPath, actualLinear));
 
     TIME_OPERATION(9, safestPath1(city));
     TIME_OPERATION(9, safestPath2(city));
     TIME_OPERATION(9, safestPath3(city));
+    TIME_OPERATION(9, safestPathDP(city));
 }
 
 STUDENT_TEST("Complicated example"){
@@ -403,14 +900,19 @@ STUDENT_TEST("Complicated example"){
     Vector<street> actual1 = safestPath1(city);
     Vector<street> actual2 = safestPath2(city);
     Vector<street> actual3 = safestPath2(city);
+    Vector<street> actualDP = safestPathDP(city);
+    Vector<street> actualLinear = safestPathLinear(city);
 
     EXPECT(areEqual(expectedPath, actual1));
     EXPECT(areEqual(expectedPath, actual2));
     EXPECT(areEqual(expectedPath, actual3));
+    EXPECT(areEqual(expectedPath, actualDP));
+    EXPECT(areEqual(expectedPath, actualLinear));
 
     TIME_OPERATION(25, safestPath1(city));
     TIME_OPERATION(25, safestPath2(city));
     TIME_OPERATION(25, safestPath3(city));
+    TIME_OPERATION(25, safestPathDP(city));
 }
 
 STUDENT_TEST("More complicated example"){
@@ -430,14 +932,19 @@ STUDENT_TEST("More complicated example"){
     Vector<street> actual1 = safestPath1(city);
     Vector<street> actual2 = safestPath2(city);
     Vector<street> actual3 = safestPath2(city);
+    Vector<street> actualDP = safestPathDP(city);
+    Vector<street> actualLinear = safestPathLinear(city);
 
     EXPECT(areEqual(expectedPath, actual1));
     EXPECT(areEqual(expectedPath, actual2));
     EXPECT(areEqual(expectedPath, actual3));
+    EXPECT(areEqual(expectedPath, actualDP));
+    EXPECT(areEqual(expectedPath, actualLinear));
 
     TIME_OPERATION(30, safestPath1(city));
     TIME_OPERATION(30, safestPath2(city));
     TIME_OPERATION(30, safestPath3(city));
+    TIME_OPERATION(30, safestPathDP(city));
 }
 
 
@@ -455,10 +962,165 @@ STUDENT_TEST("Two paths of same safety rating"){
     Vector<street> actual1 = safestPath1(city);
     Vector<street> actual2 = safestPath2(city);
     Vector<street> actual3 = safestPath2(city);
+    Vector<street> actualDP = safestPathDP(city);
+    Vector<street> actualLinear = safestPathLinear(city);
 
 
     EXPECT(areEqual(expectedPath1, actual1) || areEqual(expectedPath2, actual1));
     EXPECT(areEqual(expectedPath1, actual2) || areEqual(expectedPath2, actual2));
     EXPECT(areEqual(expectedPath1, actual3) || areEqual(expectedPath2, actual3));
+    EXPECT(areEqual(actual2, actualDP));
+    EXPECT(areEqual(actualDP, actualLinear));
+    EXPECT(areEqual(actual1, actualDP));
+
+    Vector<Vector<street>> topTwo = safestPathsTopK(city, 2);
+    EXPECT_EQUAL(topTwo.size(), 2);
+    EXPECT(areEqual(expectedPath1, topTwo[0]));
+    EXPECT(areEqual(expectedPath2, topTwo[1]));
+}
+
+/* Adds every right/down path from (row, col) to the exit onto routes. */
+void allRoutes(const CityGrid& grid, int row, int col, Vector<GridLocation>& route,
+               Vector<Vector<GridLocation>>& routes){
+    route.add(GridLocation(row, col));
+    if (row == grid.numRows() - 1 && col == grid.numCols() - 1){
+        routes.add(route);
+    }
+    if (col < grid.numCols() - 1 && grid.isSidewalk(row, col + 1)){
+        allRoutes(grid, row, col + 1, route, routes);
+    }
+    if (row < grid.numRows() - 1 && grid.isSidewalk(row + 1, col)){
+        allRoutes(grid, row + 1, col, route, routes);
+    }
+    route.remove(route.size() - 1);
+}
+
+STUDENT_TEST("Top K paths match ranking every path"){
+    for (unsigned seed = 1; seed <= 30; seed++){
+        Grid<street> city = makeTestCity(2 + seed % 4, 2 + seed % 5, seed);
+        CityGrid grid(city);
+        Vector<Vector<GridLocation>> routes;
+        Vector<GridLocation> route;
+        if (grid.isWalkable(0, 0)){
+            allRoutes(grid, 0, 0, route, routes);
+        }
+
+        /* allRoutes tries right before down, so a stable sort by safety
+         * gives the order safestRoutesTopK promises.
+         */
+        Vector<int> safety;
+        for (const Vector<GridLocation>& r : routes){
+            safety.add(getPathSafetyVector(streetsAlong(city, r)));
+        }
+        Vector<int> order;
+        for (int i = 0; i < routes.size(); i++){
+            order.add(i);
+        }
+        stable_sort(order.begin(), order.end(), [&](int a, int b){
+            return safety[a] > safety[b];
+        });
+
+        if (routes.isEmpty()){
+            EXPECT_ERROR(safestRoutesTopK(grid, 3));
+            continue;
+        }
+        for (int k = 1; k <= 8; k++){
+            Vector<Vector<GridLocation>> top = safestRoutesTopK(grid, k);
+            EXPECT_EQUAL(top.size(), min(k, routes.size()));
+            for (int i = 0; i < top.size(); i++){
+                EXPECT(top[i] == routes[order[i]]);
+            }
+        }
+    }
+}
+
+STUDENT_TEST("No path through the city"){
+    street sdwlk =  street(2, 3,  4, false);
+    street street1 =  street(10, 1, 1, true);
+
+    Grid<street> city = {{street1, sdwlk},
+                         {sdwlk, street1}};
+
+    EXPECT_ERROR(safestPath2(city));
+    EXPECT_ERROR(safestPath3(city));
+    EXPECT_ERROR(safestPathDP(city));
+    EXPECT_ERROR(safestPathLinear(city));
+}
+
+STUDENT_TEST("Iterative solver matches the dynamic programming solver and reuses its arena"){
+    for (unsigned seed = 1; seed <= 30; seed++){
+        Grid<street> city = makeTestCity(4 + seed % 4, 3 + seed % 5, seed);
+        bool hasPath = true;
+        Vector<street> expected;
+        try {
+            expected = safestPathDP(city);
+        } catch (...) {
+            hasPath = false;
+        }
+        if (!hasPath){
+            EXPECT_ERROR(safestPath3(city));
+            continue;
+        }
+        EXPECT(areEqual(safestPath3(city), expected));
+    }
+
+    /* Every street gets one node, so the search stays small on a big open
+     * city, and a second query on the same arena doesn't grow it.
+     */
+    CityProfile profile;
+    profile.sidewalkChance = 1;
+    profile.badBlockChance = 0;
+    CityGrid city(CityGenerator(60, 60, 3, profile).city());
+    PathArena arena;
+    SolveStats first;
+    SolveStats second;
+    Vector<GridLocation> route = safestPath3Helper(city, arena, first);
+    size_t bytes = arena.capacityBytes();
+    int growths = arena.growths();
+    EXPECT_EQUAL(arena.size(), 60 * 60);
+    EXPECT_EQUAL(safestPath3Helper(city, arena, second), route);
+    EXPECT_EQUAL(arena.capacityBytes(), bytes);
+    EXPECT_EQUAL(arena.growths(), growths);
+    EXPECT_EQUAL(second.pathsCreated, first.pathsCreated);
+}
+
+STUDENT_TEST("Dynamic programming on a 20x20 campus"){
+    street sdwlk =  street(2, 3,  4, false);
+    street street1 =  street(10, 1, 1, true);
+    street street2 =  street(0, 0, 0, true);
+    street street3 = street(50, 1, 60, true);
+
+    Grid<street> city(20, 20);
+    for (int row = 0; row < city.numRows(); row++){
+        for (int col = 0; col < city.numCols(); col++){
+            int pick = (row * 7 + col * 13) % 10;
+            if (pick == 0 && row != 0 && col != 0){
+                city[row][col] = sdwlk;
+            }
+            else if (pick < 4){
+                city[row][col] = street2;
+            }
+            else if (pick < 8){
+                city[row][col] = street1;
+            }
+            else {
+                city[row][col] = street3;
+            }
+        }
+    }
+    city[19][19] = street2;
+
+    Vector<street> actualDP = safestPathDP(city);
+    EXPECT_EQUAL(actualDP.size(), 39);
+    for (street s : actualDP){
+        EXPECT(s.isSidewalk());
+    }
+
+    long peakBytes = 0;
+    EXPECT(areEqual(actualDP, safestPathLinear(city, peakBytes)));
+    EXPECT(peakBytes <= 2 * city.numCols() * long(sizeof(int)));
+
+    TIME_OPERATION(400, safestPathDP(city));
+    TIME_OPERATION(400, safestPathLinear(city));
 }
 
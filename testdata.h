@@ -0,0 +1,44 @@
+/*
+ * Repeatable inputs for the tests and benchmarks. These are not part of
+ * the solvers' or codecs' interface; only the test cases at the bottom of
+ * each file and the programs in bench/ include them.
+ */
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include "grid.h"
+#include "street.h"
+
+/**
+ * Builds a rows x cols city from a repeatable mix of streets, with
+ * about one street in eight not a sidewalk and plenty of tied ratings.
+ * The entry and exit are always sidewalks.
+ */
+inline Grid<street> makeTestCity(int rows, int cols, unsigned seed) {
+    Grid<street> city(rows, cols);
+    for (int row = 0; row < rows; row++) {
+        for (int col = 0; col < cols; col++) {
+            seed = seed * 1103515245 + 12345;
+            int pick = (seed >> 16) % 8;
+            city[row][col] = street(pick % 3, pick % 2, pick % 4, pick != 0);
+        }
+    }
+    city[0][0] = street(0, 0, 0, true);
+    city[rows - 1][cols - 1] = street(0, 0, 0, true);
+    return city;
+}
+
+/**
+ * Builds size characters of text that is mostly a few common characters,
+ * like a text file or a city snapshot, repeatably from the seed.
+ */
+inline std::string makeTestText(size_t size, unsigned seed) {
+    std::string text(size, ' ');
+    for (size_t i = 0; i < size; i++) {
+        seed = seed * 1103515245 + 12345;
+        int pick = (seed >> 16) % 100;
+        text[i] = char(pick < 60 ? 'a' + pick % 6 : pick * 2);
+    }
+    return text;
+}
@@ -0,0 +1,267 @@
+#include "tiledpath.h"
+#include "safestpath.h"
+#include "error.h"
+#include "trace.h"
+#include "testing/SimpleTest.h"
+#include "testdata.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+namespace {
+    /* Blocks each caller of wait() until count callers have arrived, then
+     * lets them all go and resets for the next round.
+     */
+    class Barrier {
+    public:
+        explicit Barrier(int count) : _count(count) {}
+
+        void wait() {
+            unique_lock<mutex> lock(_mutex);
+            int generation = _generation;
+            if (++_waiting == _count) {
+                _waiting = 0;
+                _generation++;
+                _released.notify_all();
+            } else {
+                _released.wait(lock, [&] { return generation != _generation; });
+            }
+        }
+
+    private:
+        mutex _mutex;
+        condition_variable _released;
+        int _count;
+        int _waiting = 0;
+        int _generation = 0;
+    };
+
+    /* Everything one call to safestRouteTiled shares between its threads.
+     * Each tile writes only its own edges and decision bits, and only reads
+     * edges of tiles from the previous tile diagonal, so no locking is
+     * needed beyond the barrier between diagonals.
+     */
+    class TiledSolve {
+    public:
+        TiledSolve(const CityGrid& grid, int tileSize)
+            : _grid(grid),
+              _tileSize(tileSize),
+              _tileRows((grid.numRows() + tileSize - 1) / tileSize),
+              _tileCols((grid.numCols() + tileSize - 1) / tileSize),
+              _wordsPerTile((size_t(tileSize) * tileSize + 63) / 64),
+              _topEdges(size_t(_tileRows) * _tileCols),
+              _leftEdges(size_t(_tileRows) * _tileCols),
+              _goDown(size_t(_tileRows) * _tileCols * _wordsPerTile, 0) {}
+
+        int numTileDiagonals() const {
+            return _tileRows + _tileCols - 1;
+        }
+        int firstTileRow(int diagonal) const {
+            return max(0, diagonal - _tileCols + 1);
+        }
+        int tilesOn(int diagonal) const {
+            return min(_tileRows - 1, diagonal) - firstTileRow(diagonal) + 1;
+        }
+
+        /* Scores every street of tile (tileRow, tileCol) bottom row first,
+         * right to left, keeping one row of scores in scratch.
+         */
+        void solveTile(int tileRow, int tileCol, vector<int32_t>& scratch) {
+            int rows = _grid.numRows();
+            int cols = _grid.numCols();
+            int fromRow = tileRow * _tileSize;
+            int fromCol = tileCol * _tileSize;
+            int height = min(_tileSize, rows - fromRow);
+            int width = min(_tileSize, cols - fromCol);
+
+            size_t tile = tileIndex(tileRow, tileCol);
+            const int32_t* below = (tileRow + 1 < _tileRows)
+                    ? _topEdges[tileIndex(tileRow + 1, tileCol)].data() : nullptr;
+            const int32_t* right = (tileCol + 1 < _tileCols)
+                    ? _leftEdges[tileIndex(tileRow, tileCol + 1)].data() : nullptr;
+            vector<int32_t>& leftEdge = _leftEdges[tile];
+            leftEdge.assign(height, kNoPath);
+            uint64_t* goDown = _goDown.data() + tile * _wordsPerTile;
+            scratch.assign(width, kNoPath);
+
+            for (int r = height - 1; r >= 0; r--) {
+                int row = fromRow + r;
+                const int32_t* safety = _grid.safetyRow(row) + fromCol;
+                int32_t rightScore = right ? right[r] : kNoPath;
+                for (int c = width - 1; c >= 0; c--) {
+                    int col = fromCol + c;
+                    int32_t downScore = (r == height - 1) ? (below ? below[c] : kNoPath) : scratch[c];
+                    int32_t score = kNoPath;
+                    if (!_grid.isWalkable(row, col)) {
+                        score = kNoPath;
+                    } else if (row == rows - 1 && col == cols - 1) {
+                        score = safety[c];
+                    } else {
+                        int32_t best = max(rightScore, downScore);
+                        if (best != kNoPath) {
+                            score = safety[c] + best;
+                        }
+                        if (downScore > rightScore) {
+                            size_t bit = size_t(r) * _tileSize + c;
+                            goDown[bit / 64] |= uint64_t(1) << (bit % 64);
+                        }
+                    }
+                    scratch[c] = score;
+                    rightScore = score;
+                }
+                leftEdge[r] = scratch[0];
+            }
+            _topEdges[tile] = scratch;
+        }
+
+        /* The scores kept along tile edges, and the bytes they and the
+         * decision bits take up, once every tile is solved.
+         */
+        size_t edgeScores() const {
+            size_t scores = 0;
+            for (size_t tile = 0; tile < _topEdges.size(); tile++) {
+                scores += _topEdges[tile].size() + _leftEdges[tile].size();
+            }
+            return scores;
+        }
+        size_t tableBytes() const {
+            return edgeScores() * sizeof(int32_t) + _goDown.size() * sizeof(uint64_t);
+        }
+
+        int32_t entryScore() const {
+            return _topEdges[0][0];
+        }
+
+        bool stepsDown(int row, int col) const {
+            size_t tile = tileIndex(row / _tileSize, col / _tileSize);
+            size_t bit = size_t(row % _tileSize) * _tileSize + col % _tileSize;
+            return (_goDown[tile * _wordsPerTile + bit / 64] >> (bit % 64)) & 1;
+        }
+
+    private:
+        size_t tileIndex(int tileRow, int tileCol) const {
+            return size_t(tileRow) * _tileCols + tileCol;
+        }
+
+        const CityGrid& _grid;
+        int _tileSize;
+        int _tileRows;
+        int _tileCols;
+        size_t _wordsPerTile;
+        vector<vector<int32_t>> _topEdges;
+        vector<vector<int32_t>> _leftEdges;
+        vector<uint64_t> _goDown;
+    };
+}
+
+Vector<GridLocation> safestRouteTiled(const CityGrid& grid, int numThreads, int tileSize,
+                                      SolveStats* stats) {
+    if (tileSize < 1) {
+        error("Tile size must be at least one.");
+    }
+    if (numThreads <= 0) {
+        numThreads = max(1, int(thread::hardware_concurrency()));
+    }
+
+    TiledSolve solve(grid, tileSize);
+    int diagonals = solve.numTileDiagonals();
+    numThreads = min(numThreads, solve.tilesOn(diagonals / 2));
+
+    /* One claim counter per tile diagonal, so nothing has to be reset
+     * between diagonals.
+     */
+    vector<atomic<int>> claimed(diagonals);
+    for (atomic<int>& counter : claimed) counter = 0;
+    Barrier barrier(numThreads);
+
+    auto work = [&]() {
+        TraceSpan working("tiled worker");
+        vector<int32_t> scratch;
+        for (int d = diagonals - 1; d >= 0; d--) {
+            int first = solve.firstTileRow(d);
+            int count = solve.tilesOn(d);
+            for (int t = claimed[d]++; t < count; t = claimed[d]++) {
+                TraceSpan solving("tile");
+                solve.solveTile(first + t, d - first - t, scratch);
+            }
+            TraceSpan waiting("barrier wait");
+            barrier.wait();
+        }
+    };
+
+    vector<thread> workers;
+    for (int i = 1; i < numThreads; i++) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (thread& worker : workers) {
+        worker.join();
+    }
+
+    if (stats) {
+        *stats = SolveStats();
+        stats->cellsVisited = (long long)grid.numRows() * grid.numCols();
+        stats->pathsCreated = stats->cellsVisited;
+        stats->bytesAllocated = solve.tableBytes() + size_t(numThreads) * tileSize * sizeof(int32_t);
+        stats->peakFrontier = solve.edgeScores();
+    }
+    if (solve.entryScore() == kNoPath) {
+        error("There is no safe path through the city.");
+    }
+
+    TraceSpan rebuilding("safestRouteTiled path reconstruction");
+    Vector<GridLocation> route;
+    int row = 0;
+    int col = 0;
+    route.add(GridLocation(row, col));
+    while (row != grid.numRows() - 1 || col != grid.numCols() - 1) {
+        if (solve.stepsDown(row, col)) {
+            row++;
+        } else {
+            col++;
+        }
+        route.add(GridLocation(row, col));
+    }
+    return route;
+}
+
+Vector<street> safestPathTiled(const Grid<street>& city, int numThreads, int tileSize) {
+    CityGrid grid(city);
+    return streetsAlong(city, safestRouteTiled(grid, numThreads, tileSize));
+}
+
+
+STUDENT_TEST("Tiled solver matches the dynamic programming solver"){
+    Vector<GridLocation> sizes = {{1, 1}, {1, 9}, {9, 1}, {5, 5}, {13, 40}, {40, 13}, {33, 33}};
+    Vector<int> tileSizes = {1, 2, 3, 8, 64};
+    for (GridLocation size : sizes){
+        for (unsigned seed = 1; seed <= 8; seed++){
+            Grid<street> city = makeTestCity(size.row, size.col, seed);
+            CityGrid grid(city);
+
+            bool hasPath = true;
+            Vector<GridLocation> expected;
+            try {
+                expected = safestRouteDP(grid);
+            } catch (...) {
+                hasPath = false;
+            }
+            for (int tileSize : tileSizes){
+                for (int threads = 1; threads <= 4; threads *= 2){
+                    if (hasPath){
+                        EXPECT(expected == safestRouteTiled(grid, threads, tileSize));
+                    }
+                    else {
+                        EXPECT_ERROR(safestRouteTiled(grid, threads, tileSize));
+                    }
+                }
+            }
+        }
+    }
+    EXPECT_ERROR(safestRouteTiled(CityGrid(makeTestCity(4, 4, 1)), 1, 0));
+}
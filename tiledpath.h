@@ -0,0 +1,39 @@
+/*
+ * Multi-threaded safest path solver.
+ *
+ * The city is cut into square tiles. A tile only needs the scores along
+ * the left edge of the tile to its right and the top edge of the tile
+ * below it, so every tile on one tile anti-diagonal can be solved at the
+ * same time. The tile diagonals are swept from the exit back to the entry
+ * on a fixed pool of threads, with a barrier between diagonals.
+ */
+#pragma once
+
+#include "grid.h"
+#include "vector.h"
+#include "street.h"
+#include "citygrid.h"
+#include "solvestats.h"
+
+/* Default edge length, in streets, of one tile. */
+const int kDefaultTileSize = 256;
+
+/**
+ * Returns the locations of the safest path through the city, solving
+ * tiles in parallel. It returns exactly the path safestRouteDP returns,
+ * for any thread count and tile size.
+ *
+ * numThreads is the number of threads to use, counting the caller;
+ * zero or less means one per hardware thread. tileSize is the edge
+ * length of a tile and must be at least one.
+ *
+ * Besides the path, it keeps one decision bit per street and the scores
+ * along two edges of every tile. If stats is not null it is filled in
+ * with how much work the solve did.
+ */
+Vector<GridLocation> safestRouteTiled(const CityGrid& grid, int numThreads = 0,
+                                      int tileSize = kDefaultTileSize, SolveStats* stats = nullptr);
+
+/** Builds a CityGrid for the city and solves it with safestRouteTiled. */
+Vector<street> safestPathTiled(const Grid<street>& city, int numThreads = 0,
+                               int tileSize = kDefaultTileSize);
@@ -0,0 +1,324 @@
+#include "trace.h"
+#include "safestpath.h"
+#include "citygrid.h"
+#include "citygen.h"
+#include "testing/SimpleTest.h"
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+#ifndef SAFESTPATH_NO_TRACE
+
+atomic<bool> traceOn(false);
+
+namespace {
+    const uint64_t kSpansPerThread = 1 << 15;
+
+    struct Span {
+        const char* name;
+        int64_t start;
+        int64_t end;
+        uint32_t thread;
+    };
+
+    /* One thread's spans. Only the thread that owns the ring adds to it;
+     * it fills in the slot before publishing the new count, so a reader
+     * that loads the count sees every span before it whole.
+     */
+    class SpanRing {
+    public:
+        SpanRing() : _spans(kSpansPerThread), _written(0), _cleared(0) {}
+
+        void add(const Span& span) {
+            uint64_t n = _written.load(memory_order_relaxed);
+            _spans[n % kSpansPerThread] = span;
+            _written.store(n + 1, memory_order_release);
+        }
+
+        void clear() {
+            _cleared = _written.load(memory_order_acquire);
+        }
+
+        uint64_t recorded() const {
+            return _written.load(memory_order_acquire) - _cleared.load();
+        }
+
+        /* The spans still in the ring since the last clear, oldest first. */
+        vector<Span> spans() const {
+            uint64_t n = _written.load(memory_order_acquire);
+            uint64_t first = max(_cleared.load(), n > kSpansPerThread ? n - kSpansPerThread : 0);
+            vector<Span> result;
+            for (uint64_t i = first; i < n; i++) {
+                result.push_back(_spans[i % kSpansPerThread]);
+            }
+            return result;
+        }
+
+    private:
+        vector<Span> _spans;
+        atomic<uint64_t> _written;
+        atomic<uint64_t> _cleared;
+    };
+
+    /* Rings outlive their threads, so spans from workers that have
+     * finished still get written out. A finished thread's ring is handed
+     * to the next thread that starts recording, which gets a new id. The
+     * lock is only taken when a thread records its first span or exits.
+     */
+    struct Registry {
+        mutex lock;
+        vector<unique_ptr<SpanRing>> rings;
+        vector<SpanRing*> unused;
+        uint32_t nextThread = 1;
+    };
+
+    /* Never destroyed, so threads that exit during shutdown can still hand back their rings. */
+    Registry& registry() {
+        static Registry* registry = new Registry;
+        return *registry;
+    }
+
+    struct ThreadRing {
+        SpanRing* ring = nullptr;
+        uint32_t thread = 0;
+
+        ~ThreadRing() {
+            if (ring != nullptr) {
+                Registry& all = registry();
+                lock_guard<mutex> lock(all.lock);
+                all.unused.push_back(ring);
+            }
+        }
+    };
+
+    thread_local ThreadRing threadRing;
+
+    const chrono::steady_clock::time_point traceEpoch = chrono::steady_clock::now();
+
+    /* Writes nanoseconds as microseconds, which is what Chrome traces use. */
+    void writeMicros(ostream& out, int64_t nanos) {
+        string fraction = to_string(nanos % 1000);
+        out << nanos / 1000 << "." << string(3 - fraction.size(), '0') << fraction;
+    }
+
+    void writeJsonString(ostream& out, const char* text) {
+        out << '"';
+        for (const char* c = text; *c != '\0'; c++) {
+            if (*c == '"' || *c == '\\') {
+                out << '\\' << *c;
+            } else if (uint8_t(*c) < 0x20) {
+                out << ' ';
+            } else {
+                out << *c;
+            }
+        }
+        out << '"';
+    }
+}
+
+int64_t traceNow() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - traceEpoch).count();
+}
+
+void recordSpan(const char* name, int64_t start, int64_t end) {
+    ThreadRing& mine = threadRing;
+    if (mine.ring == nullptr) {
+        Registry& all = registry();
+        lock_guard<mutex> lock(all.lock);
+        if (all.unused.empty()) {
+            all.rings.push_back(make_unique<SpanRing>());
+            mine.ring = all.rings.back().get();
+        } else {
+            mine.ring = all.unused.back();
+            all.unused.pop_back();
+        }
+        mine.thread = all.nextThread++;
+    }
+    mine.ring->add({name, start, end, mine.thread});
+}
+
+void setTracing(bool enabled) {
+    traceOn = enabled;
+}
+
+bool tracingEnabled() {
+    return traceOn;
+}
+
+void clearTrace() {
+    Registry& all = registry();
+    lock_guard<mutex> lock(all.lock);
+    for (const unique_ptr<SpanRing>& ring : all.rings) {
+        ring->clear();
+    }
+}
+
+long long traceSpansRecorded() {
+    Registry& all = registry();
+    lock_guard<mutex> lock(all.lock);
+    long long total = 0;
+    for (const unique_ptr<SpanRing>& ring : all.rings) {
+        total += ring->recorded();
+    }
+    return total;
+}
+
+void writeChromeTrace(ostream& out) {
+    Registry& all = registry();
+    lock_guard<mutex> lock(all.lock);
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    for (const unique_ptr<SpanRing>& ring : all.rings) {
+        for (const Span& span : ring->spans()) {
+            out << (first ? "\n" : ",\n") << "{\"name\":";
+            writeJsonString(out, span.name);
+            out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << span.thread << ",\"ts\":";
+            writeMicros(out, span.start);
+            out << ",\"dur\":";
+            writeMicros(out, span.end - span.start);
+            out << "}";
+            first = false;
+        }
+    }
+    out << "\n]}" << endl;
+}
+
+#else
+
+void setTracing(bool) {
+}
+
+bool tracingEnabled() {
+    return false;
+}
+
+void clearTrace() {
+}
+
+long long traceSpansRecorded() {
+    return 0;
+}
+
+void writeChromeTrace(ostream& out) {
+    out << "{\"traceEvents\":[]}" << endl;
+}
+
+#endif
+
+
+#ifndef SAFESTPATH_NO_TRACE
+
+namespace {
+    string traceText() {
+        ostringstream out;
+        writeChromeTrace(out);
+        return out.str();
+    }
+
+    int countOf(const string& text, const string& part) {
+        int count = 0;
+        for (size_t at = text.find(part); at != string::npos; at = text.find(part, at + 1)) {
+            count++;
+        }
+        return count;
+    }
+}
+
+STUDENT_TEST("Spans are only recorded while tracing is on"){
+    clearTrace();
+    setTracing(false);
+    {
+        TraceSpan span("off span");
+    }
+    setTracing(true);
+    {
+        TraceSpan outer("outer span");
+        TraceSpan inner("inner \"quoted\" span");
+        inner.end();
+        inner.end();
+    }
+    setTracing(false);
+
+    string trace = traceText();
+    EXPECT_EQUAL(trace.substr(0, 16), "{\"traceEvents\":[");
+    EXPECT_EQUAL(countOf(trace, "off span"), 0);
+    EXPECT_EQUAL(countOf(trace, "\"outer span\""), 1);
+    EXPECT_EQUAL(countOf(trace, "\"inner \\\"quoted\\\" span\""), 1);
+    EXPECT_EQUAL(countOf(trace, "\"ph\":\"X\""), 2);
+    EXPECT_EQUAL(traceSpansRecorded(), 2);
+
+    clearTrace();
+    EXPECT_EQUAL(countOf(traceText(), "\"ph\""), 0);
+    EXPECT_EQUAL(traceSpansRecorded(), 0);
+}
+
+STUDENT_TEST("Each thread's spans get their own thread id"){
+    clearTrace();
+    setTracing(true);
+    vector<thread> workers;
+    for (int i = 0; i < 3; i++){
+        workers.emplace_back([]() {
+            TraceSpan span("worker span");
+        });
+    }
+    for (thread& worker : workers){
+        worker.join();
+    }
+    {
+        TraceSpan span("worker span");
+    }
+    setTracing(false);
+
+    string trace = traceText();
+    set<string> threads;
+    for (size_t at = trace.find("\"tid\":"); at != string::npos; at = trace.find("\"tid\":", at + 1)){
+        threads.insert(trace.substr(at, trace.find(',', at) - at));
+    }
+    EXPECT_EQUAL(countOf(trace, "worker span"), 4);
+    EXPECT_EQUAL(threads.size(), 4);
+}
+
+STUDENT_TEST("A full ring keeps the newest spans"){
+    clearTrace();
+    setTracing(true);
+    for (int i = 0; i < 10; i++){
+        TraceSpan span("early span");
+    }
+    for (uint64_t i = 0; i < kSpansPerThread; i++){
+        TraceSpan span("late span");
+    }
+    setTracing(false);
+
+    string trace = traceText();
+    EXPECT_EQUAL(countOf(trace, "early span"), 0);
+    EXPECT_EQUAL(countOf(trace, "late span"), int(kSpansPerThread));
+    EXPECT_EQUAL(traceSpansRecorded(), (long long)kSpansPerThread + 10);
+    clearTrace();
+}
+
+STUDENT_TEST("Solves record their phases"){
+    CityProfile profile;
+    profile.sidewalkChance = 1;
+    profile.badBlockChance = 0;
+    Grid<street> city = CityGenerator(20, 30, 1, profile).city();
+    clearTrace();
+    setTracing(true);
+    safestPathDP(city);
+    safestPath3(CityGenerator(4, 4, 1, profile).city());
+    setTracing(false);
+
+    string trace = traceText();
+    EXPECT(countOf(trace, "\"grid conversion\"") >= 2);
+    EXPECT_EQUAL(countOf(trace, "\"safestRouteDP search\""), 1);
+    EXPECT_EQUAL(countOf(trace, "\"safestRouteDP path reconstruction\""), 1);
+    EXPECT(countOf(trace, "\"vector conversion\"") >= 2);
+    clearTrace();
+}
+
+#endif
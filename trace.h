@@ -0,0 +1,91 @@
+/*
+ * Trace spans record when each phase of a solve or a file read starts and
+ * how long it takes, on every thread, so a slow query can be looked at as
+ * a timeline rather than one number.
+ *
+ * A TraceSpan starts when it is made and ends when it goes out of scope or
+ * end() is called. Spans nest, and writeChromeTrace writes every recorded
+ * span as Chrome trace JSON, which opens in Perfetto or chrome://tracing.
+ *
+ * Tracing starts off. While it is off a span costs one relaxed atomic load
+ * when it starts and one test when it ends. While it is on, each thread
+ * records into its own ring buffer without taking any lock; when a buffer
+ * fills, the oldest spans are overwritten. Buffers are only read by
+ * writeChromeTrace and clearTrace, which should be called once the traced
+ * threads are quiet.
+ *
+ * Building with SAFESTPATH_NO_TRACE defined compiles spans away entirely.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+
+/** Turns recording on or off for every thread. */
+void setTracing(bool enabled);
+
+/** Returns whether spans are being recorded. */
+bool tracingEnabled();
+
+/** Throws away every span recorded so far. */
+void clearTrace();
+
+/**
+ * Returns how many spans have been recorded since the last clearTrace,
+ * counting any that a full ring has since overwritten.
+ */
+long long traceSpansRecorded();
+
+/** Writes every recorded span, oldest first on each thread, as Chrome trace JSON. */
+void writeChromeTrace(std::ostream& out);
+
+#ifndef SAFESTPATH_NO_TRACE
+
+/* Read by every TraceSpan; change it with setTracing. */
+extern std::atomic<bool> traceOn;
+
+/* Nanoseconds on a steady clock since the program started. */
+int64_t traceNow();
+
+/* Adds a finished span to the calling thread's buffer. */
+void recordSpan(const char* name, int64_t start, int64_t end);
+
+class TraceSpan {
+public:
+    /** name must outlive the trace; in practice it is a string literal. */
+    explicit TraceSpan(const char* name) : _name(name), _start(-1) {
+        if (traceOn.load(std::memory_order_relaxed)) {
+            _start = traceNow();
+        }
+    }
+
+    ~TraceSpan() {
+        end();
+    }
+
+    /** Ends the span early. Later calls do nothing. */
+    void end() {
+        if (_start >= 0) {
+            recordSpan(_name, _start, traceNow());
+            _start = -1;
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator =(const TraceSpan&) = delete;
+
+private:
+    const char* _name;
+    int64_t _start;
+};
+
+#else
+
+class TraceSpan {
+public:
+    explicit TraceSpan(const char*) {}
+    void end() {}
+};
+
+#endif
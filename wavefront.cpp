@@ -0,0 +1,225 @@
+#include "wavefront.h"
+#include "safestpath.h"
+#include "error.h"
+#include "testing/SimpleTest.h"
+#include "testdata.h"
+#include <algorithm>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define WAVEFRONT_X86 1
+#include <immintrin.h>
+#endif
+using namespace std;
+
+WavefrontCity::WavefrontCity(const CityGrid& grid)
+    : _numRows(grid.numRows()),
+      _numCols(grid.numCols()),
+      _safety(size_t(grid.numRows()) * grid.numCols()),
+      _offsets(grid.numRows() + grid.numCols() - 1) {
+    size_t offset = 0;
+    for (int d = 0; d < numDiagonals(); d++) {
+        _offsets[d] = offset;
+        offset += length(d);
+    }
+    for (int row = 0; row < _numRows; row++) {
+        for (int col = 0; col < _numCols; col++) {
+            int d = row + col;
+            _safety[_offsets[d] + row - firstRow(d)] =
+                    grid.isWalkable(row, col) ? grid.safety(row, col) : kNoPath;
+        }
+    }
+}
+
+namespace {
+    /*
+     * A kernel scores one anti-diagonal. For lane i, next[i] is the score of
+     * the street to the right and next[i + 1] the score of the street below.
+     * It writes the lane's score to cur[i] and sets bit i of goDown when the
+     * path should step down rather than right. goDown has one byte for every
+     * eight lanes. Ties go right, which matches safestRouteDP.
+     */
+    typedef void (*DiagonalKernel)(const int32_t* safety, const int32_t* next,
+                                   int32_t* cur, uint8_t* goDown, int length);
+
+    void scalarKernel(const int32_t* safety, const int32_t* next,
+                      int32_t* cur, uint8_t* goDown, int length) {
+        for (int i = 0; i < length; i += 8) {
+            uint8_t bits = 0;
+            int end = min(length, i + 8);
+            for (int j = i; j < end; j++) {
+                int right = next[j];
+                int down = next[j + 1];
+                int best = max(right, down);
+                if (down > right) {
+                    bits |= uint8_t(1U << (j - i));
+                }
+                cur[j] = (safety[j] == kNoPath || best == kNoPath) ? kNoPath : safety[j] + best;
+            }
+            goDown[i / 8] = bits;
+        }
+    }
+
+#ifdef WAVEFRONT_X86
+    /* Same as scalarKernel, eight lanes at a time. Lanes that hold kNoPath
+     * are masked back to kNoPath after the add, so what the add does with
+     * them doesn't matter.
+     */
+    __attribute__((target("avx2")))
+    void avx2Kernel(const int32_t* safety, const int32_t* next,
+                    int32_t* cur, uint8_t* goDown, int length) {
+        const __m256i noPath = _mm256_set1_epi32(kNoPath);
+        int i = 0;
+        for (; i + 8 <= length; i += 8) {
+            __m256i s     = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(safety + i));
+            __m256i right = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(next + i));
+            __m256i down  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(next + i + 1));
+
+            __m256i best = _mm256_max_epi32(right, down);
+            __m256i blocked = _mm256_or_si256(_mm256_cmpeq_epi32(s, noPath),
+                                              _mm256_cmpeq_epi32(best, noPath));
+            __m256i score = _mm256_blendv_epi8(_mm256_add_epi32(s, best), noPath, blocked);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(cur + i), score);
+
+            __m256i stepDown = _mm256_cmpgt_epi32(down, right);
+            goDown[i / 8] = uint8_t(_mm256_movemask_ps(_mm256_castsi256_ps(stepDown)));
+        }
+        if (i < length) {
+            scalarKernel(safety + i, next + i, cur + i, goDown + i / 8, length - i);
+        }
+    }
+#endif
+
+    DiagonalKernel kernelFor(WavefrontKernel kernel) {
+        if (kernel == WavefrontKernel::Auto) {
+            kernel = wavefrontHasAVX2() ? WavefrontKernel::AVX2 : WavefrontKernel::Scalar;
+        }
+        if (kernel == WavefrontKernel::AVX2) {
+#ifdef WAVEFRONT_X86
+            if (wavefrontHasAVX2()) return avx2Kernel;
+#endif
+            error("The AVX2 wavefront kernel is not supported on this CPU.");
+        }
+        return scalarKernel;
+    }
+}
+
+bool wavefrontHasAVX2() {
+#ifdef WAVEFRONT_X86
+    static const bool hasAVX2 = __builtin_cpu_supports("avx2");
+    return hasAVX2;
+#else
+    return false;
+#endif
+}
+
+/**
+ * Scores travel between two buffers indexed by row plus one, so that the
+ * row above the first row and the row below the last row can hold kNoPath.
+ * After each diagonal is scored, the two rows just outside it are reset to
+ * kNoPath because the next diagonal reads them as out-of-bounds neighbors.
+ *
+ * Let N be the number of rows and M be the number of columns. The sweep is
+ * O(NM) and keeps O(N) scores plus one decision bit per street.
+ */
+Vector<GridLocation> safestRouteWavefront(const WavefrontCity& city, WavefrontKernel kernel,
+                                          SolveStats* stats) {
+    DiagonalKernel scoreDiagonal = kernelFor(kernel);
+    int rows = city.numRows();
+    int cols = city.numCols();
+    int last = city.numDiagonals() - 1;
+
+    vector<size_t> bitOffsets(city.numDiagonals());
+    size_t bitBytes = 0;
+    for (int d = 0; d < city.numDiagonals(); d++) {
+        bitOffsets[d] = bitBytes;
+        bitBytes += (city.length(d) + 7) / 8;
+    }
+    vector<uint8_t> goDown(bitBytes);
+
+    vector<int32_t> next(rows + 2, kNoPath);
+    vector<int32_t> cur(rows + 2, kNoPath);
+    next[rows] = city.diagonal(last)[0];
+
+    for (int d = last - 1; d >= 0; d--) {
+        int first = city.firstRow(d);
+        int length = city.length(d);
+        scoreDiagonal(city.diagonal(d), next.data() + first + 1, cur.data() + first + 1,
+                      goDown.data() + bitOffsets[d], length);
+        cur[first] = kNoPath;
+        cur[first + length + 1] = kNoPath;
+        swap(cur, next);
+    }
+
+    if (stats) {
+        *stats = SolveStats();
+        stats->cellsVisited = (long long)rows * cols;
+        stats->pathsCreated = stats->cellsVisited;
+        stats->bytesAllocated = bitBytes + (next.size() + cur.size()) * sizeof(int32_t);
+        stats->peakFrontier = min(rows, cols);
+    }
+    if (next[1] == kNoPath) {
+        error("There is no safe path through the city.");
+    }
+
+    Vector<GridLocation> route;
+    int row = 0;
+    int col = 0;
+    route.add(GridLocation(row, col));
+    while (row != rows - 1 || col != cols - 1) {
+        int d = row + col;
+        int lane = row - city.firstRow(d);
+        if ((goDown[bitOffsets[d] + lane / 8] >> (lane % 8)) & 1) {
+            row++;
+        } else {
+            col++;
+        }
+        route.add(GridLocation(row, col));
+    }
+    return route;
+}
+
+Vector<street> safestPathWavefront(const Grid<street>& city, SolveStats* stats) {
+    CityGrid grid(city);
+    WavefrontCity diagonals(grid);
+    return streetsAlong(city, safestRouteWavefront(diagonals, WavefrontKernel::Auto, stats));
+}
+
+
+STUDENT_TEST("Wavefront kernels match the dynamic programming solver"){
+    Vector<GridLocation> sizes = {{1, 1}, {1, 9}, {9, 1}, {2, 2}, {3, 17},
+                                  {17, 3}, {8, 8}, {31, 45}, {64, 9}};
+    for (GridLocation size : sizes){
+        for (unsigned seed = 1; seed <= 20; seed++){
+            Grid<street> city = makeTestCity(size.row, size.col, seed);
+            CityGrid grid(city);
+            WavefrontCity diagonals(grid);
+
+            bool hasPath = true;
+            Vector<GridLocation> expected;
+            try {
+                expected = safestRouteDP(grid);
+            } catch (...) {
+                hasPath = false;
+            }
+            if (!hasPath){
+                EXPECT_ERROR(safestRouteWavefront(diagonals, WavefrontKernel::Scalar));
+                continue;
+            }
+            EXPECT(expected == safestRouteWavefront(diagonals, WavefrontKernel::Scalar));
+            if (wavefrontHasAVX2()){
+                EXPECT(expected == safestRouteWavefront(diagonals, WavefrontKernel::AVX2));
+            }
+        }
+    }
+}
+
+STUDENT_TEST("Wavefront timing on a 1000x1000 city"){
+    Grid<street> city = makeTestCity(1000, 1000, 7);
+    CityGrid grid(city);
+    WavefrontCity diagonals(grid);
+
+    TIME_OPERATION(1000000, safestRouteDP(grid));
+    TIME_OPERATION(1000000, safestRouteWavefront(diagonals, WavefrontKernel::Scalar));
+    if (wavefrontHasAVX2()){
+        TIME_OPERATION(1000000, safestRouteWavefront(diagonals, WavefrontKernel::AVX2));
+    }
+}
@@ -0,0 +1,92 @@
+/*
+ * Anti-diagonal wavefront solver for the safest right/down path.
+ *
+ * The best score from a street to the exit only depends on the street to
+ * its right and the street below it, and both of those lie on the next
+ * anti-diagonal (row + col + 1). Sweeping the anti-diagonals from the exit
+ * back to the entry therefore lets every street on one diagonal be scored
+ * at the same time, which maps onto SIMD max/add lanes.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "grid.h"
+#include "vector.h"
+#include "street.h"
+#include "citygrid.h"
+#include "solvestats.h"
+
+/**
+ * A copy of a CityGrid laid out one anti-diagonal after another, so that
+ * the streets of a diagonal are contiguous in memory. Streets that can't
+ * be walked on hold kNoPath instead of a safety rating. Build it once per
+ * city and reuse it for every solve.
+ */
+class WavefrontCity {
+public:
+    explicit WavefrontCity(const CityGrid& grid);
+
+    int numRows() const {
+        return _numRows;
+    }
+    int numCols() const {
+        return _numCols;
+    }
+    int numDiagonals() const {
+        return _numRows + _numCols - 1;
+    }
+
+    /** First row of the given anti-diagonal. */
+    int firstRow(int diagonal) const {
+        return diagonal < _numCols ? 0 : diagonal - _numCols + 1;
+    }
+    /** Number of streets on the given anti-diagonal. */
+    int length(int diagonal) const {
+        int lastRow = diagonal < _numRows ? diagonal : _numRows - 1;
+        return lastRow - firstRow(diagonal) + 1;
+    }
+
+    /** Safety ratings of the given anti-diagonal, ordered by row. */
+    const int32_t* diagonal(int diagonal) const {
+        return _safety.data() + _offsets[diagonal];
+    }
+    /** Position of the given anti-diagonal within a per-street array. */
+    size_t offset(int diagonal) const {
+        return _offsets[diagonal];
+    }
+
+private:
+    int _numRows;
+    int _numCols;
+    std::vector<int32_t> _safety;
+    std::vector<size_t> _offsets;
+};
+
+/** Which inner loop safestRouteWavefront uses. */
+enum class WavefrontKernel {
+    Auto,   // AVX2 if this CPU has it, scalar otherwise
+    Scalar,
+    AVX2
+};
+
+/** Returns whether the AVX2 kernel can run on this CPU. */
+bool wavefrontHasAVX2();
+
+/**
+ * Returns the locations of the safest path through the city by sweeping
+ * anti-diagonals. It returns exactly the path safestRouteDP returns,
+ * whichever kernel is used. Asking for the AVX2 kernel on a CPU without
+ * AVX2 is an error. If stats is not null it is filled in with how much
+ * work the solve did.
+ */
+Vector<GridLocation> safestRouteWavefront(const WavefrontCity& city,
+                                          WavefrontKernel kernel = WavefrontKernel::Auto,
+                                          SolveStats* stats = nullptr);
+
+/**
+ * Builds the diagonal layout for the city and solves it. If stats is not
+ * null it is filled in with how much work the solve did.
+ */
+Vector<street> safestPathWavefront(const Grid<street>& city, SolveStats* stats = nullptr);